@@ -0,0 +1,89 @@
+#include <core/math.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <chrono>
+#include <vector>
+
+/* Bounding box of an array of positions with the vector path of         */
+/* `Box::include` against the scalar loop. The vector path is AVX when   */
+/* built with MV_ENABLE_AVX and SSE2 otherwise on x86-64.                */
+/* Usage: box-benchmark [positions] [repeats]                            */
+
+using namespace mv;
+
+#if defined( __AVX__ )
+static const char* vector_path = "avx";
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+static const char* vector_path = "sse2";
+#else
+static const char* vector_path = "none";
+#endif
+
+static Box scalar_box( const glm::dvec3* positions, size_t count ) {
+  Box box;
+  for ( size_t i = 0; i < count; i++ )
+    box.include( positions[i] );
+  return box;
+}
+
+static Box vector_box( const glm::dvec3* positions, size_t count ) {
+  Box box;
+  box.include( positions, count );
+  return box;
+}
+
+static bool same( const Box& a, const Box& b ) {
+  return a.min == b.min && a.max == b.max;
+}
+
+template<typename F>
+static double elapsed_us( F function ) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count();
+}
+
+int main( int argc, char** argv ) {
+  size_t num_positions = argc > 1 ? std::strtoull( argv[1], nullptr, 10 ) : 4000000;
+  size_t repeats = argc > 2 ? std::strtoull( argv[2], nullptr, 10 ) : 20;
+
+  std::mt19937_64 random( 1 );
+  std::uniform_real_distribution<double> coordinate( -1000.0, 1000.0 );
+
+  std::vector<glm::dvec3> positions( std::max<size_t>( num_positions, 64 ) );
+  for ( auto& position : positions )
+    position = glm::dvec3( coordinate( random ), coordinate( random ), coordinate( random ) );
+
+  /* every count around the width of the registers, the remainder loop included */
+  size_t mismatches = 0;
+  for ( size_t count = 0; count <= 40; count++ ) {
+    for ( size_t first = 0; first < 4; first++ ) {
+      if ( !same( scalar_box( positions.data() + first, count ), vector_box( positions.data() + first, count ) ) )
+        mismatches++;
+    }
+  }
+
+  Box scalar, vector;
+  double scalar_us = elapsed_us( [&] () {
+    for ( size_t i = 0; i < repeats; i++ )
+      scalar.unify( scalar_box( positions.data(), num_positions ) );
+  } );
+
+  double vector_us = elapsed_us( [&] () {
+    for ( size_t i = 0; i < repeats; i++ )
+      vector.unify( vector_box( positions.data(), num_positions ) );
+  } );
+
+  if ( !same( scalar, vector ) )
+    mismatches++;
+
+  double runs = (double)std::max<size_t>( repeats, 1 );
+  std::printf( "positions %zu, repeats %zu, vector path %s\n", num_positions, repeats, vector_path );
+  std::printf( "scalar loop %10.1f us per box\n", scalar_us / runs );
+  std::printf( "vector path %10.1f us per box\n", vector_us / runs );
+  std::printf( "%zu boxes differ from the scalar loop\n", mismatches );
+
+  return mismatches == 0 ? 0 : 1;
+}
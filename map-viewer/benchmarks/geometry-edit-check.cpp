@@ -0,0 +1,75 @@
+#include <app/geometry.h>
+
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+/* Vertex removal and insertion mark the polygon with the vertex dirty,    */
+/* also at the end of a sub-polygon where the vertex is next to the start  */
+/* of the following one. Every edit is made on a fresh geometry of two     */
+/* polygons, the first one with two sub-polygons.                          */
+/* Usage: geometry-edit-check                                              */
+
+using namespace mv;
+
+static Geometry make_geometry( void ) {
+  const glm::dvec3 outer[] = { { 0.0, 0.0, 0.0 }, { 4.0, 0.0, 0.0 }, { 4.0, 4.0, 0.0 }, { 0.0, 4.0, 0.0 } };
+  const glm::dvec3 hole[]  = { { 1.0, 1.0, 0.0 }, { 2.0, 1.0, 0.0 }, { 2.0, 2.0, 0.0 }, { 1.0, 2.0, 0.0 } };
+  const glm::dvec3 other[] = { { 5.0, 0.0, 0.0 }, { 6.0, 0.0, 0.0 }, { 6.0, 1.0, 0.0 } };
+
+  Geometry geometry;
+  geometry.push_sub_polygon( outer, 4 );
+  geometry.push_sub_polygon( hole, 4 );
+  geometry.end_polygon();
+  geometry.push_sub_polygon( other, 3 );
+  geometry.end_polygon();
+  return geometry;
+}
+
+/* is only `polygon` dirty */
+static bool only_dirty( const Geometry& geometry, uint32_t polygon ) {
+  const std::vector<uint32_t>& dirty = geometry.dirty_polygons();
+  return dirty.size() == 1 && dirty[0] == polygon;
+}
+
+int main( void ) {
+  size_t failures = 0;
+
+  /* remove every vertex, the first and the last of each sub-polygon included */
+  for ( vertex_index index = 0; index < make_geometry().vertices(); index++ ) {
+    Geometry geometry = make_geometry();
+    uint32_t polygon = geometry.polygon_of( index );
+    uint32_t vertices = geometry.polygon( polygon ).vertices();
+
+    geometry.remove( index );
+    if ( !only_dirty( geometry, polygon ) || geometry.polygon( polygon ).vertices() != vertices - 1 ) {
+      std::printf( "removing vertex %u did not mark polygon %u dirty\n", index, polygon );
+      failures++;
+    }
+  }
+
+  /* the last vertex of the first sub-polygon, the outer ring keeps three vertices */
+  {
+    Geometry geometry = make_geometry();
+    geometry.remove( 3 );
+    if ( !only_dirty( geometry, 0 ) || geometry.polygon( 0 ).sub_polygon( 0 ).vertices() != 3 || geometry.sub_polygon_offset( 1 ) != 3 ) {
+      std::printf( "removing the last vertex of sub-polygon 0 changed the wrong sub-polygon\n" );
+      failures++;
+    }
+  }
+
+  /* insert at every offset, an offset at the end of a sub-polygon appends to it */
+  for ( vertex_index offset = 1; offset <= make_geometry().vertices(); offset++ ) {
+    Geometry geometry = make_geometry();
+    uint32_t polygon = geometry.polygon_of( offset - 1 );
+
+    geometry.insert( offset, glm::dvec3( 3.0, 3.0, 0.0 ) );
+    if ( !only_dirty( geometry, polygon ) ) {
+      std::printf( "inserting at offset %u did not mark polygon %u dirty\n", offset, polygon );
+      failures++;
+    }
+  }
+
+  std::printf( "%zu edits marked the wrong polygons dirty\n", failures );
+  return failures == 0 ? 0 : 1;
+}
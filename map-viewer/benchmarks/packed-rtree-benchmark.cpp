@@ -0,0 +1,109 @@
+#include <app/packed-rtree.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+/* Queries of the packed R-tree against a linear scan over the same boxes. */
+/* Usage: packed-rtree-benchmark [boxes] [queries]                         */
+
+using namespace mv;
+
+static bool overlaps( const Box& a, const Box& b ) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+/* a small random box in the unit square */
+static Box random_box( std::mt19937_64& random, double size ) {
+  std::uniform_real_distribution<double> position( 0.0, 1.0 ), extent( 0.0, size );
+
+  Box box;
+  glm::dvec3 min( position( random ), position( random ), 0.0 );
+  box.include( min );
+  box.include( min + glm::dvec3( extent( random ), extent( random ), 0.0 ) );
+  return box;
+}
+
+template<typename F>
+static double elapsed_us( F function ) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count();
+}
+
+int main( int argc, char** argv ) {
+  size_t num_boxes = argc > 1 ? std::strtoull( argv[1], nullptr, 10 ) : 100000;
+  size_t num_queries = argc > 2 ? std::strtoull( argv[2], nullptr, 10 ) : 2000;
+
+  std::mt19937_64 random( 1 );
+
+  /* boxes of about the size of the geometries of a dense layer */
+  double box_size = 2.0 / std::sqrt( (double)std::max<size_t>( num_boxes, 1 ) );
+  std::vector<Box> boxes( num_boxes );
+  for ( auto& box : boxes )
+    box = random_box( random, box_size );
+
+  PackedRTree tree;
+  double build_us = elapsed_us( [&] () { tree.build( boxes ); } );
+
+  /* some of the boxes move like edited geometries, the tree gets looser */
+  for ( size_t i = 0; i < num_boxes / 100; i++ ) {
+    uint32_t item = (uint32_t)( random() % num_boxes );
+    boxes[item] = random_box( random, box_size );
+    tree.update( item, boxes[item] );
+  }
+
+  /* queries of about a hundred boxes, like a zoomed in view */
+  std::vector<Box> queries( num_queries );
+  for ( auto& query : queries )
+    query = random_box( random, box_size * 10.0 );
+
+  std::vector<uint32_t> tree_items, scan_items;
+  size_t tree_found = 0, scan_found = 0, mismatches = 0;
+
+  double tree_us = elapsed_us( [&] () {
+    for ( const auto& query : queries ) {
+      tree_items.clear();
+      tree.query( query, tree_items );
+      tree_found += tree_items.size();
+    }
+  } );
+
+  double scan_us = elapsed_us( [&] () {
+    for ( const auto& query : queries ) {
+      scan_items.clear();
+      for ( uint32_t i = 0; i < (uint32_t)boxes.size(); i++ ) {
+        if ( overlaps( boxes[i], query ) )
+          scan_items.push_back( i );
+      }
+      scan_found += scan_items.size();
+    }
+  } );
+
+  /* the timed loops only count, the results are compared apart */
+  for ( const auto& query : queries ) {
+    tree_items.clear();
+    scan_items.clear();
+
+    tree.query( query, tree_items );
+    for ( uint32_t i = 0; i < (uint32_t)boxes.size(); i++ ) {
+      if ( overlaps( boxes[i], query ) )
+        scan_items.push_back( i );
+    }
+
+    std::sort( tree_items.begin(), tree_items.end() );
+    if ( tree_items != scan_items )
+      mismatches++;
+  }
+
+  std::printf( "boxes %zu, queries %zu, build %.1f ms\n", num_boxes, num_queries, build_us / 1000.0 );
+  std::printf( "packed r-tree %10.2f us per query\n", tree_us / (double)std::max<size_t>( num_queries, 1 ) );
+  std::printf( "linear scan   %10.2f us per query\n", scan_us / (double)std::max<size_t>( num_queries, 1 ) );
+  std::printf( "found %zu boxes, %zu queries differ from the scan\n", tree_found, mismatches + ( tree_found != scan_found ) );
+
+  return mismatches == 0 && tree_found == scan_found ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include <types.h>
+
+namespace mv {
+
+  /* type of a single attribute value */
+  enum class AttributeType : uint8_t {
+    Null,
+    Bool,
+    Int,
+    Double,
+    String
+  };
+
+  /* Attributes of all the geometries of a layer stored by column. The      */
+  /* names of the columns are stored once for the whole table and every     */
+  /* cell keeps its own type next to a 64 bit value, which is the number    */
+  /* itself or refers to a string. A cell that was never set is null, so    */
+  /* rows may have different columns.                                       */
+  /*                                                                        */
+  /* Strings of a column with few distinct values are dictionary encoded,   */
+  /* the value of the cell is a code into the dictionary of the column and  */
+  /* every distinct string is stored once. Every column starts encoded and  */
+  /* falls back to plain strings, which are indices in the string pool of   */
+  /* the table, as soon as it is seen to have too many distinct values. The */
+  /* pool keeps all its strings in one array of characters.                 */
+  class AttributeTable {
+  public:
+    static constexpr uint32_t INVALID_COLUMN = 0xFFFFFFFF;
+
+    /* string cells seen in a column before deciding on its encoding */
+    static constexpr size_t DICTIONARY_SAMPLE = 256;
+
+    /* a column stays encoded while it has at most one distinct string in this many */
+    static constexpr size_t DICTIONARY_RATIO = 4;
+
+    /* and while it has at most this many distinct strings, whatever the ratio */
+    static constexpr size_t DICTIONARY_MAX_VALUES = 1 << 16;
+  public:
+    AttributeTable( void );
+    ~AttributeTable( void );
+  public:
+    /* return the index of the column with `name`, it is added if not present */
+    uint32_t column( const string& name );
+
+    /* return the index of the column with `name` or `INVALID_COLUMN` */
+    uint32_t find_column( const string& name ) const;
+
+    /* add a row at the end with all the cells null */
+    void add_row( void );
+
+    /* Remove the last row and undo everything that was added for it, the */
+    /* strings, the new dictionary entries and the columns first seen in  */
+    /* the row.                                                           */
+    void pop_row( void );
+
+    /* Set the cell of the last row in `column`. A cell is only set once per */
+    /* row, for a duplicate key in a feature the first value is kept.        */
+    void set_null( uint32_t column );
+    void set_bool( uint32_t column, bool value );
+    void set_int( uint32_t column, int64_t value );
+    void set_double( uint32_t column, double value );
+    void set_string( uint32_t column, std::string_view value );
+
+    /* append all the rows of `other`, the columns are matched by name */
+    void append( const AttributeTable& other );
+
+    /* remove everything */
+    void clear( void );
+
+    /* read the cells, the type must match */
+    inline AttributeType type( size_t row, uint32_t column ) const { return _columns[column].types[row]; }
+    inline bool get_bool( size_t row, uint32_t column ) const { return _columns[column].values[row] != 0; }
+    inline int64_t get_int( size_t row, uint32_t column ) const { return (int64_t)_columns[column].values[row]; }
+    double get_double( size_t row, uint32_t column ) const;
+    std::string_view get_string( size_t row, uint32_t column ) const;
+
+    /* text of the cell as shown to the user */
+    string to_string( size_t row, uint32_t column ) const;
+
+    /* Order of two cells in `column`, negative, zero or positive. Nulls come */
+    /* first, then booleans, numbers and strings. `ranks` must be the result  */
+    /* of `dictionary_ranks` for the column if it is dictionary encoded.      */
+    int compare( size_t a, size_t b, uint32_t column, const std::vector<uint32_t>& ranks ) const;
+
+    inline size_t rows( void ) const { return _rows; }
+    inline uint32_t columns( void ) const { return (uint32_t)_columns.size(); }
+    inline const string& column_name( uint32_t column ) const { return _columns[column].name; }
+
+    /* The dictionary of an encoded column, the value of a string cell in */
+    /* the column is the code of the string in the dictionary.            */
+    inline bool is_dictionary( uint32_t column ) const { return _columns[column].encoded; }
+    inline uint32_t code( size_t row, uint32_t column ) const { return (uint32_t)_columns[column].values[row]; }
+    inline size_t dictionary_size( uint32_t column ) const { return _columns[column].dictionary.size(); }
+    inline const string& dictionary_value( uint32_t column, uint32_t code ) const { return _columns[column].dictionary[code]; }
+
+    /* position of every code of the dictionary in the sorted order of the strings */
+    std::vector<uint32_t> dictionary_ranks( uint32_t column ) const;
+
+    /* Raw storage of a column and of the string pool, the value of a plain   */
+    /* string cell is an index in the pool. Used to save and load the table.  */
+    inline const std::vector<AttributeType>& column_types( uint32_t column ) const { return _columns[column].types; }
+    inline const std::vector<uint64_t>& column_values( uint32_t column ) const { return _columns[column].values; }
+    inline size_t pool_size( void ) const { return _string_ends.size(); }
+    std::string_view pool_string( size_t index ) const;
+
+    /* Replace the table with raw storage, `types` and `values` hold `rows`   */
+    /* cells for every column one column after the other. `strings` holds     */
+    /* the string pool followed by the dictionaries of the columns in order,  */
+    /* a column with a dictionary size of zero has plain strings. Returns     */
+    /* false and leaves the table empty if the storage is not consistent.     */
+    bool assign( const std::vector<string>& names, const uint64_t* dictionary_sizes, size_t rows, const AttributeType* types,
+                 const uint64_t* values, std::vector<string> strings );
+  private:
+    struct Column {
+      string                     name;
+      std::vector<AttributeType> types;
+      std::vector<uint64_t>      values;
+
+      /* the distinct strings of an encoded column and their codes */
+      bool                                 encoded = true;
+      std::vector<string>                  dictionary;
+      std::unordered_map<string, uint32_t> dictionary_index;
+      size_t                               string_cells = 0;
+
+      /* the last row has a value in this column if it equals the number of rows */
+      size_t set_rows = 0;
+
+      /* size of the dictionary and number of string cells before the last row */
+      size_t last_row_dictionary   = 0;
+      size_t last_row_string_cells = 0;
+    };
+
+    /* returns false if the cell of the last row is already set */
+    bool set( uint32_t column, AttributeType type, uint64_t value );
+
+    /* remember the sizes of everything before the last row, for `pop_row` */
+    void mark_last_row( void );
+
+    /* return the code of `value` in the dictionary of `column`, added if not present */
+    uint32_t intern( Column& column, std::string_view value );
+
+    /* move the strings of an encoded column with too many distinct values to the pool */
+    void check_encoding( Column& column );
+
+    /* add a string at the end of the pool */
+    void add_pool_string( std::string_view value );
+  private:
+    std::vector<Column> _columns;
+
+    /* index of every column by name */
+    std::unordered_map<string, uint32_t> _column_index;
+
+    /* Strings of the columns which are not dictionary encoded, one after */
+    /* the other, the n-th string ends at the n-th offset. A string is    */
+    /* added without an allocation of its own.                            */
+    string                _string_chars;
+    std::vector<uint64_t> _string_ends;
+
+    /* size of the string pool and number of columns before the last row was added */
+    size_t   _last_row_strings = 0;
+    uint32_t _last_row_columns = 0;
+
+    /* reused to look up strings in the dictionaries without allocating */
+    string _lookup;
+
+    size_t _rows = 0;
+  };
+
+}
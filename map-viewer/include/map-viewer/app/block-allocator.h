@@ -0,0 +1,55 @@
+#pragma once
+
+#include <map>
+#include <types.h>
+
+namespace mv {
+
+  /* Free list over the elements of a buffer, a block is a range of      */
+  /* elements handed out by `allocate` and given back by `free`. A block */
+  /* is taken from the first free block it fits in, otherwise from the   */
+  /* end of the buffer which grows. The free blocks are merged with      */
+  /* their free neighbours.                                              */
+  class BlockAllocator {
+  public:
+    /* how the elements of the buffer are used */
+    struct Stats {
+      size_t used         = 0;
+      size_t free         = 0;
+      size_t free_blocks  = 0;
+      size_t largest_free = 0;
+
+      /* part of the free elements outside of the largest free block */
+      inline double fragmentation( void ) const { return free > 0 ? 1.0 - (double)largest_free / (double)free : 0.0; }
+    };
+  public:
+    BlockAllocator( void );
+    ~BlockAllocator( void );
+  public:
+    /* start again with the first `size` elements used and none free */
+    void reset( size_t size );
+
+    /* return the offset of a block of `count` elements, the buffer grows if no free block fits */
+    size_t allocate( size_t count );
+
+    /* give back the block of `count` elements at `offset` */
+    void free( size_t offset, size_t count );
+
+    /* return how the elements are used */
+    Stats stats( void ) const;
+
+    /* return the number of elements in the buffer, used or free */
+    inline size_t size( void ) const { return _size; }
+
+    /* return the number of free elements */
+    inline size_t free_size( void ) const { return _free_size; }
+  private:
+    /* size of every free block by its offset */
+    std::map<size_t, size_t> _free;
+
+    /* number of elements in the buffer and in the free blocks */
+    size_t _size      = 0;
+    size_t _free_size = 0;
+  };
+
+}
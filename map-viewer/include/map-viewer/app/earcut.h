@@ -122,8 +122,15 @@ namespace mapbox {
         template <typename... Args>
         T* construct( Args&&... args ) {
           if ( currentIndex >= blockSize ) {
-            currentBlock = alloc_traits::allocate( alloc, blockSize );
-            allocations.emplace_back( currentBlock );
+            // move to the next block kept by `rewind` before allocating a new one
+            if ( ++currentBlockIndex < allocations.size() ) {
+              currentBlock = allocations[currentBlockIndex];
+            }
+            else {
+              currentBlock = alloc_traits::allocate( alloc, blockSize );
+              allocations.emplace_back( currentBlock );
+              currentBlockIndex = allocations.size() - 1;
+            }
             currentIndex = 0;
           }
           T* object = &currentBlock[currentIndex++];
@@ -137,18 +144,34 @@ namespace mapbox {
           allocations.clear();
           blockSize = std::max<std::size_t>( 1, newBlockSize );
           currentBlock = nullptr;
+          currentBlockIndex = std::size_t( -1 );
           currentIndex = blockSize;
         }
         void clear() { reset( blockSize ); }
+        // forget the objects but keep the blocks, the objects are trivially destructible
+        void rewind() {
+          currentBlock = nullptr;
+          currentBlockIndex = std::size_t( -1 );
+          currentIndex = blockSize;
+        }
+        // rewind, the blocks are only reallocated when they are smaller than `newBlockSize`
+        void reuse( std::size_t newBlockSize ) {
+          if ( newBlockSize > blockSize ) reset( newBlockSize );
+          else rewind();
+        }
       private:
         T* currentBlock = nullptr;
         std::size_t currentIndex = 1;
+        std::size_t currentBlockIndex = std::size_t( -1 );
         std::size_t blockSize = 1;
         std::vector<T*> allocations;
         Alloc alloc;
         typedef typename std::allocator_traits<Alloc> alloc_traits;
       };
       ObjectPool<Node> nodes;
+
+      // holes waiting to be linked, kept to reuse its memory
+      std::vector<Node*> queue;
     };
 
     template <typename N> template <typename Polygon>
@@ -169,8 +192,8 @@ namespace mapbox {
         len += points[i].size();
       }
 
-      //estimate size of nodes and indices
-      nodes.reset( len * 3 / 2 );
+      //estimate size of nodes and indices, the blocks of the previous call are reused
+      nodes.reuse( len * 3 / 2 );
       indices.reserve( len + points[0].size() );
 
       Node* outerNode = linkedList( points[0], true );
@@ -201,7 +224,7 @@ namespace mapbox {
 
       earcutLinked( outerNode );
 
-      nodes.clear();
+      nodes.rewind();
     }
 
     // create a circular doubly linked list from polygon points in the specified winding order
@@ -448,7 +471,7 @@ namespace mapbox {
       Earcut<N>::eliminateHoles( const Polygon& points, Node* outerNode ) {
       const size_t len = points.size();
 
-      std::vector<Node*> queue;
+      queue.clear();
       for ( size_t i = 1; i < len; i++ ) {
         Node* list = linkedList( points[i], false );
         if ( list ) {
@@ -2,286 +2,768 @@
 
 #include <vector>
 #include <array>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <string_view>
 
 #include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
-#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
 #include <rapidjson/encodings.h>
 #include <rapidjson/stringbuffer.h>
-#include <rapidjson/prettywriter.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/error/en.h>
 
 #include <utils/logger.h>
 #include <utils/file-reader.h>
 
-#include <app/earcut.h>
+#include <core/thread-pool.h>
+
 #include <app/geometry.h>
+#include <app/attribute-table.h>
 
 namespace mv {
 
-  static Ref<Geometry> process_multi_polygon( rapidjson::Value& coordinates ) {
-    using namespace rapidjson;
+  /* Called once for every feature as soon as it is completely parsed, the */
+  /* properties of the n-th feature are in the n-th row of the table.      */
+  using feature_callback = std::function<void( Ref<Geometry> )>;
+
+  /* SAX handler for geojson files. Instead of building a document for the  */
+  /* entire file the reader push tokens to this handler and the handler     */
+  /* assemble one feature at a time. As soon as a feature object is closed  */
+  /* the geometry is passed to the callback and all the internal state is   */
+  /* reset, so the memory used is bounded by the largest feature in the     */
+  /* file and not by the size of the file. Both a root array of features    */
+  /* and a `FeatureCollection` with a `features` member are understood.     */
+  /* The properties are added to `attributes` as typed values, one row per  */
+  /* feature passed to the callback. Nested objects and arrays are stored   */
+  /* as json text.                                                          */
+  class GeoJSONHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, GeoJSONHandler> {
+  private:
+    /* the json objects and arrays that we care about, everything else is skipped */
+    enum class Scope {
+      Collection,
+      Features,
+      Feature,
+      Properties,
+      Geometry
+    };
+  public:
+    GeoJSONHandler( feature_callback on_feature, AttributeTable& attributes ) :
+      _on_feature( on_feature ), _attributes( attributes ), _value_writer( _value_buffer ) {}
+  public:
+    /* Used when the features are parsed one at a time, the root value */
+    /* of every parse is then handled as an element of `features`.     */
+    void expect_features( void ) { _scopes.assign( 1, Scope::Features ); }
+
+    /* the parse stops after the feature in which `progress` is cancelled */
+    void set_progress( TaskProgress* progress ) { _progress = progress; }
+
+    bool Null( void ) {
+      if ( is_skipping() || in_coordinates() ) return true;
+      if ( in_property_value() ) return property_scalar( [&] () { return _value_writer.Null(); }, [&] ( uint32_t column ) { _attributes.set_null( column ); } );
+
+      /* A null `properties` is not an object, it is reported and the */
+      /* feature is loaded without properties, the parse goes on.     */
+      if ( top() == Scope::Feature && _key == "properties" ) {
+        LOG_WARN( "the list of properties of a feature is null; loading it without properties" );
+        _has_properties = true;
+      }
 
-    /* create the geometry object */
-    Ref<Geometry> geometry = new Geometry();
+      return true;
+    }
 
-    /* check if the list of array has a array type */
-    if ( coordinates.GetType() != kArrayType ) {
-      LOG_ERROR( "the list of coordinates does not have array type; cannot proceed" );
-      return {};
+    bool Bool( bool b ) {
+      if ( is_skipping() || in_coordinates() ) return true;
+      if ( in_property_value() ) return property_scalar( [&] () { return _value_writer.Bool( b ); }, [&] ( uint32_t column ) { _attributes.set_bool( column, b ); } );
+      return true;
     }
 
-    /* number of polygons, these polygons may have sub polygons as well */
-    uint32_t num_polygons = coordinates.GetArray().Size();
+    bool Int( int i )          { return number( i, [&] () { return _value_writer.Int( i ); }, [&] ( uint32_t column ) { _attributes.set_int( column, i ); } ); }
+    bool Uint( unsigned u )    { return number( u, [&] () { return _value_writer.Uint( u ); }, [&] ( uint32_t column ) { _attributes.set_int( column, u ); } ); }
+    bool Int64( int64_t i )    { return number( (double)i, [&] () { return _value_writer.Int64( i ); }, [&] ( uint32_t column ) { _attributes.set_int( column, i ); } ); }
+    bool Double( double d )    { return number( d, [&] () { return _value_writer.Double( d ); }, [&] ( uint32_t column ) { _attributes.set_double( column, d ); } ); }
+
+    /* integers beyond the range of `int64_t` are kept as doubles */
+    bool Uint64( uint64_t u ) {
+      return number( (double)u, [&] () { return _value_writer.Uint64( u ); }, [&] ( uint32_t column ) {
+        if ( u > (uint64_t)INT64_MAX )
+          _attributes.set_double( column, (double)u );
+        else
+          _attributes.set_int( column, (int64_t)u );
+      } );
+    }
 
-    /* process the polygons */
-    for ( uint32_t i = 0; i < num_polygons; i++ ) {
+    bool String( const char* str, rapidjson::SizeType length, bool copy ) {
+      if ( is_skipping() ) return true;
+
+      if ( in_coordinates() ) {
+        LOG_ERROR( "coordinates must be laid as an array of numbers, the type does not match; cannot proceed" );
+        _position_valid = false;
+        return true;
+      }
 
-      /* current polygon */
-      Polygon polygon;
+      /* string property values are stored as they are */
+      if ( in_property_value() ) {
+        if ( _value_depth > 0 )
+          return _value_writer.String( str, length, copy );
 
-      /* In `MultiPolygon` the polygons can have sub polygons and the polygons are laid as list */
-      /* of sub polygons ( even if there is only 1 ). So the type must be array.                */
-      if ( coordinates[i].GetType() != kArrayType ) {
-        LOG_ERROR( "in `MultiPolygon` the polygon must have a list of subpolygons but none is found; cannot proceed" );
-        continue;
+        _attributes.set_string( _attributes.column( _key ), std::string_view( str, length ) );
+        return true;
       }
 
-      /* sub polygons in a multi polygon */
-      uint32_t sub_polygons = coordinates[i].GetArray().Size();
+      if ( top() == Scope::Feature && _key == "type" )
+        _feature_type.assign( str, length );
+      else if ( top() == Scope::Geometry && _key == "type" )
+        _geometry_type.assign( str, length );
 
-      /* process sub polygons */
-      for ( uint32_t j = 0; j < sub_polygons; j++ ) {
-        SubPolygon sub_polygon;
-        Value& polygon_coords = coordinates[i][j];
+      return true;
+    }
 
-        /* all sub polygons must have array of coordinates */
-        if ( polygon_coords.GetType() != kArrayType ) {
-          LOG_ERROR( "polygons must have a array of coordinates but none is found; cannot proceed" );
-          continue;
-        }
+    bool Key( const char* str, rapidjson::SizeType length, bool copy ) {
+      if ( is_skipping() ) return true;
+      if ( _value_depth > 0 ) return _value_writer.Key( str, length, copy );
 
-        /* get the number of coordinates */
-        uint32_t num_coordinates = polygon_coords.GetArray().Size();
+      _key.assign( str, length );
+      return true;
+    }
 
-        /* process the coordinates, ignore the last coordinate because it is same as the first */
-        for ( uint32_t k = 0; k < num_coordinates - 1; k++ ) {
+    bool StartObject( void ) {
+      if ( is_skipping() ) return skip();
+      if ( in_coordinates() ) return skip();
+      if ( in_property_value() ) return begin_property_value() && _value_writer.StartObject();
+
+      if ( _scopes.empty() ) {
+        _scopes.push_back( Scope::Collection );
+      } else if ( top() == Scope::Features ) {
+        begin_feature();
+        _scopes.push_back( Scope::Feature );
+      } else if ( top() == Scope::Feature && _key == "properties" ) {
+        _has_properties = true;
+        _scopes.push_back( Scope::Properties );
+      } else if ( top() == Scope::Feature && _key == "geometry" ) {
+        _has_geometry = true;
+        _scopes.push_back( Scope::Geometry );
+      } else {
+        return skip();
+      }
 
-          /* coordinates must be array of two numbers */
-          if ( polygon_coords[k].GetType() != kArrayType ) {
-            LOG_ERROR( "coordinates must be laid as an array of numbers, the type does not match; cannot proceed" );
-            continue;
-          }
+      return true;
+    }
 
-          /* coordinate must be a array of two numbers */
-          if ( polygon_coords[k].GetArray().Size() != 2 ) {
-            LOG_ERROR( "each coordinate must have 2 numbers laid in a array, invalid number of coordinates; cannot proceed" );
-            continue;
-          }
+    bool EndObject( rapidjson::SizeType member_count ) {
+      if ( is_skipping() ) return unskip();
+      if ( _value_depth > 0 ) return _value_writer.EndObject( member_count ) && end_property_value();
 
-          /* get the actual coordinates; finally :-) */
-          float x = polygon_coords[k][0].GetFloat();
-          float y = polygon_coords[k][1].GetFloat();
+      Scope scope = top();
+      _scopes.pop_back();
 
-          /* push them in the list of coordinate for further processing */
-          sub_polygon.push_back( { x, y, 0.0f } );
+      if ( scope == Scope::Feature ) {
+        end_feature();
 
-        }
+        /* returning false terminates the parse */
+        if ( _progress && _progress->cancelled )
+          return false;
+      }
+
+      return true;
+    }
+
+    bool StartArray( void ) {
+      if ( is_skipping() ) return skip();
+      if ( in_property_value() ) return begin_property_value() && _value_writer.StartArray();
 
-        /* push the sub polygon to a list of polygons */
-        polygon.push_back( sub_polygon );
+      if ( in_coordinates() ) {
+        _coordinate_depth++;
+
+        /* a new array at the depth of numbers is a new position */
+        _position_size = 0;
+        _position_valid = true;
+        return true;
       }
-      
-      geometry->push_back( polygon );
-
-    #if 0
-      /* After the gigantic loop above we will get a list of polygons with a list of coordinates. */
-      /* OpenGL cannot render arbitrary polygons so it must be converted to triangles now.        */
-      std::vector<uint32_t> indices = mapbox::earcut<uint32_t>( polygons );
-
-      /* use indices to build vertices array */
-      for ( size_t i = 0; i < indices.size(); i++ ) {
-        glm::vec3 vertex( 0.0f );
-        int32_t index = indices[i];
-
-        /* The index returned by `earcut` assume that the vertices     */
-        /* are laid in a single array rather than an array of polygons */
-        /* so if any index is greater than the current polygon's       */
-        /* coordinate size than it can be any of the other polygons.   */
-        for ( const auto& polygon : polygons ) {
-          if ( index > polygon.size() - 1 ) {
-            index -= polygon.size();
-            continue;
-          }
 
-          /* index must never be negative */
-          if ( index < 0 ) {
-            LOG_ERROR( "invalid index after earcut" );
-          }
+      if ( _scopes.empty() ) {
+        _scopes.push_back( Scope::Features );
+      } else if ( top() == Scope::Collection && _key == "features" ) {
+        _scopes.push_back( Scope::Features );
+      } else if ( top() == Scope::Geometry && _key == "coordinates" ) {
+        _coordinate_depth = 1;
+        _number_depth = 0;
+      } else {
+        return skip();
+      }
 
-          /* assign the vertex position leaving z coordinate to 0.0f */
-          vertex.x = polygon[(size_t)index][0];
-          vertex.y = polygon[(size_t)index][1];
-          vertex.z = 0.0f;
+      return true;
+    }
 
-          /* break the loop since we have found our index */
-          break;
-        }
+    bool EndArray( rapidjson::SizeType element_count ) {
+      if ( is_skipping() ) return unskip();
+      if ( _value_depth > 0 ) return _value_writer.EndArray( element_count ) && end_property_value();
 
-        /* assign the vertex in the vector */
-        vertices.push_back( vertex );
+      if ( in_coordinates() ) {
+        end_coordinate_array();
+        _coordinate_depth--;
+        return true;
+      }
 
-        /* include in the bounding box */
-        bbox.include( vertex );
+      _scopes.pop_back();
+      return true;
+    }
+  private:
+    /* handle a number token, coordinates are stored and property values  */
+    /* are added to the table                                             */
+    template<typename F, typename S>
+    bool number( double value, F write_value, S set_value ) {
+      if ( is_skipping() ) return true;
+
+      if ( in_coordinates() ) {
+        /* the depth of the first number is the depth of all the positions */
+        if ( _number_depth == 0 )
+          _number_depth = _coordinate_depth;
+
+        if ( _position_size < 2 )
+          _position[_position_size] = value;
+
+        _position_size++;
+        return true;
       }
 
-      /* store outlines */
-      for ( const auto& polygon : polygons ) {
-        for ( size_t i = 0; i < polygon.size() - 1; i++ ) {
-          outlines.push_back( glm::vec3( polygon[i][0], polygon[i][1], 0.0f ) );
-          outlines.push_back( glm::vec3( polygon[i + 1][0], polygon[i + 1][1], 0.0f ) );
+      if ( in_property_value() )
+        return property_scalar( write_value, set_value );
+
+      return true;
+    }
+
+    /* finish the array at the current coordinate depth, for a `MultiPolygon`     */
+    /* the positions are 4 level deep; polygon -> sub polygon -> position -> x, y */
+    void end_coordinate_array( void ) {
+      if ( _number_depth == 0 )
+        return;
+
+      if ( _coordinate_depth == _number_depth ) {
+        /* coordinate must be a array of two numbers */
+        if ( _position_size != 2 ) {
+          LOG_ERROR( "each coordinate must have 2 numbers laid in a array, invalid number of coordinates; cannot proceed" );
+          return;
         }
-      }
 
-    #endif
+        if ( _position_valid )
+          _positions.push_back( glm::dvec3( _position[0], _position[1], 0.0 ) );
+      } else if ( _coordinate_depth == _number_depth - 1 ) {
+        /* ignore the last coordinate because it is same as the first */
+        if ( _positions.size() > _ring_offsets.back() )
+          _positions.pop_back();
+
+        /* do not add empty sub-polygon */
+        if ( _positions.size() == _ring_offsets.back() )
+          LOG_WARN( "trying to insert empty sub-polygon; cannot continute" );
+        else
+          _ring_offsets.push_back( (vertex_index)_positions.size() );
+      } else if ( _coordinate_depth == _number_depth - 2 ) {
+        uint32_t rings = (uint32_t)_ring_offsets.size() - 1;
+
+        /* do not add empty polygon */
+        if ( rings == _polygon_offsets.back() )
+          LOG_WARN( "trying to insert empty sub-polygon; cannot continute" );
+        else
+          _polygon_offsets.push_back( rings );
+      }
     }
-    
-    /* return the geometry object */
-    geometry->compute_bbox();
-    return geometry;
-  }
 
-  static properties process_properties( rapidjson::Value& polygon_properties ) {
-    using namespace rapidjson;
+    /* reset the state for a new feature */
+    void begin_feature( void ) {
+      _positions.clear();
+      _ring_offsets.assign( 1, 0 );
+      _polygon_offsets.assign( 1, 0 );
+      _feature_type.clear();
+      _geometry_type.clear();
+      _has_properties = false;
+      _has_geometry = false;
+      _number_depth = 0;
+
+      /* the properties go to a new row, it is removed again if the feature is rejected */
+      _attributes.add_row();
+    }
 
-    properties props;
+    /* validate the feature and hand it over to the callback */
+    void end_feature( void ) {
+      if ( !accept_feature() ) {
+        _attributes.pop_row();
+        return;
+      }
 
-    /* check that the list of properties is an object type */
-    if ( polygon_properties.GetType() != kObjectType ) {
-      LOG_ERROR( "the list of properties does not have object type; cannot proceed" );
-      return {};
+      /* the arrays of the feature are reused, the geometry gets a copy of their size */
+      Ref<Geometry> geometry = new Geometry( _positions, _ring_offsets, _polygon_offsets );
+      geometry->compute_bbox();
+      _on_feature( geometry );
     }
 
-    /* process properties */
-    for ( auto property = polygon_properties.MemberBegin(); property < polygon_properties.MemberEnd(); property++ ) {
-      Value& key = property->name;
-      Value& val = property->value;
+    /* check the members of the feature, the errors are logged */
+    bool accept_feature( void ) const {
+      if ( _feature_type.empty() ) {
+        LOG_ERROR( "a geojson object does not have a `type` member; cannot proceed" );
+        return false;
+      }
 
-      std::string key_string;
-      std::string val_string;
+      if ( _feature_type != "Feature" ) {
+        LOG_ERROR( "invalid `type` in geojson or type handler not yet implimented: {}", _feature_type );
+        /* [TODO]: Handle other types. */
+        return false;
+      }
 
-      /* convert the key and value to string for storing */
-      if ( !key.IsString() ) {
-        rapidjson::StringBuffer key_buffer;
-        rapidjson::PrettyWriter<StringBuffer> key_writer( key_buffer );
-        key.Accept( key_writer );
+      if ( !_has_properties ) {
+        LOG_ERROR( "a geojson object does not have a `properties` member; cannot proceed" );
+        return false;
+      }
 
-        key_string = key_buffer.GetString();
-      } else {
-        key_string = key.GetString();
+      if ( !_has_geometry ) {
+        LOG_ERROR( "a geojson object does not have a `geometry` member; cannot proceed" );
+        return false;
       }
 
-      if ( !val.IsString() ) {
-        rapidjson::StringBuffer val_buffer;
-        rapidjson::PrettyWriter<StringBuffer> val_writer( val_buffer );
-        val.Accept( val_writer );
+      if ( _geometry_type.empty() ) {
+        LOG_ERROR( "a geojson object does not define the `type` of `geometry`; cannot proceed" );
+        return false;
+      }
 
-        val_string = val_buffer.GetString();
+      if ( _geometry_type != "MultiPolygon" ) {
+        LOG_ERROR( "invalid `geometry` in geojson or geometry type not yet imeplemented: {}", _geometry_type );
+        /* [TODO]: Handle other types. */
+        return false;
       }
-      else {
-        val_string = val.GetString();
+
+      return true;
+    }
+
+    /* Nested objects and arrays in the properties are written as indented */
+    /* json text by the pretty writer and stored as a string.              */
+    bool begin_property_value( void ) {
+      if ( _value_depth == 0 ) {
+        _value_buffer.Clear();
+        _value_writer.Reset( _value_buffer );
       }
-      
-      /* insert in the hash table */
-      props.insert( std::make_pair( key_string, val_string ) );
+
+      _value_depth++;
+      return true;
     }
 
-    /* return the list of properties */
-    return props;
-  }
+    template<typename F, typename S>
+    bool property_scalar( F write_value, S set_value ) {
+      /* scalars inside a nested value are part of the nested value */
+      if ( _value_depth > 0 )
+        return write_value();
 
-  static std::vector<Ref<Geometry>> load_geojson_to_buffer( const string& filename ) {
-    using namespace rapidjson;
+      set_value( _attributes.column( _key ) );
+      return true;
+    }
 
-    std::vector<Ref<Geometry>> polygons;
+    bool end_property_value( void ) {
+      if ( _value_depth > 0 )
+        _value_depth--;
+
+      if ( _value_depth == 0 ) {
+        _attributes.set_string( _attributes.column( _key ), std::string_view( _value_buffer.GetString(), _value_buffer.GetSize() ) );
+        _value_buffer.Clear();
+        _value_writer.Reset( _value_buffer );
+      }
+
+      return true;
+    }
+
+    /* skip values which are not required, the depth keeps track of nesting */
+    bool skip( void ) { _skip_depth++; return true; }
+    bool unskip( void ) { _skip_depth--; return true; }
+
+    inline Scope top( void ) const { return _scopes.back(); }
+    inline bool is_skipping( void ) const { return _skip_depth > 0; }
+    inline bool in_coordinates( void ) const { return _coordinate_depth > 0; }
+    inline bool in_property_value( void ) const { return _value_depth > 0 || ( !_scopes.empty() && top() == Scope::Properties ); }
+  private:
+    feature_callback _on_feature;
+    AttributeTable&  _attributes;
+    TaskProgress*    _progress = nullptr;
+
+    /* nesting of the json objects and arrays that are being processed */
+    std::vector<Scope> _scopes;
+
+    /* last key read in the current object */
+    string _key;
+
+    /* depth of the value being skipped, zero if not skipping */
+    uint32_t _skip_depth = 0;
+
+    /* Current feature, the positions of its sub-polygons one after the  */
+    /* other and the offsets of the sub-polygons and the polygons, laid  */
+    /* out as in `Geometry`. The arrays are reused for every feature.    */
+    std::vector<glm::dvec3>   _positions;
+    std::vector<vertex_index> _ring_offsets;
+    std::vector<uint32_t>     _polygon_offsets;
+
+    string        _feature_type;
+    string        _geometry_type;
+    bool          _has_properties = false;
+    bool          _has_geometry   = false;
+
+    /* nesting inside the `coordinates` array and the depth at which numbers are found */
+    uint32_t _coordinate_depth = 0;
+    uint32_t _number_depth     = 0;
+
+    /* position being read */
+    double   _position[2]    = { 0.0, 0.0 };
+    uint32_t _position_size  = 0;
+    bool     _position_valid = true;
+
+    /* writer for nested property values */
+    uint32_t _value_depth = 0;
+    rapidjson::StringBuffer _value_buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> _value_writer;
+  };
+
+  /* Stream the geojson file and call `on_feature` for every feature. The file */
+  /* is memory mapped and the parser reads directly from the mapping, so the   */
+  /* file is never copied and only the pages being parsed are in memory.       */
+  /* The properties are added to `attributes`, one row for every feature.      */
+  /* Returns false if the file cannot be opened or is not a valid json, in     */
+  /* that case the features passed to the callback so far must be discarded.   */
+  /* The same goes for a `progress` which is cancelled during the parse.       */
+  inline bool load_geojson( const string& filename, AttributeTable& attributes, const feature_callback& on_feature, TaskProgress* progress = nullptr ) {
+    using namespace rapidjson;
 
-    /* read the file */
-    DataFile file( filename );
+    /* map the file */
+    DataFile file( filename, DataFile::Mode::Mapped );
     if ( !file )
-      return {};
+      return false;
 
-    /* parse the json using rapidjson */
-    Document d;
-    d.Parse( file.content().c_str() );
+    MemoryStream stream( file.view().data(), file.view().size() );
 
-    /* the first entry must be an array */
-    if ( d.GetType() != kArrayType ) {
-      LOG_ERROR( "the root geojson must be a single object with a array type: {}", filename );
-      return {};
+    GeoJSONHandler handler( on_feature, attributes );
+    Reader reader;
+    handler.set_progress( progress );
+    ParseResult result = reader.Parse<kParseIterativeFlag>( stream, handler );
+
+    /* a cancelled load is not an error of the file */
+    if ( progress && progress->cancelled )
+      return false;
+
+    if ( result.IsError() ) {
+      LOG_ERROR( "failed to parse geojson file `{}`: {} (offset {})", filename, GetParseError_En( result.Code() ), result.Offset() );
+      return false;
     }
 
-    uint32_t feature_size = d.GetArray().Size();
+    return true;
+  }
 
-    for ( uint32_t i = 0; i < feature_size; i++ ) {
+  namespace detail {
 
-      /* check the type member */
-      if ( !d[i].HasMember( "type" ) ) {
-        LOG_ERROR( "a geojson object does not have a `type` member; cannot proceed" );
-        continue;
-      }
+    inline bool is_json_space( char c ) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    inline void skip_json_space( std::string_view json, size_t& i ) {
+      while ( i < json.size() && is_json_space( json[i] ) ) i++;
+    }
 
-      /* check the `type` member's value type */
-      Value& type = d[i]["type"];
-      if ( type.GetType() != kStringType ) {
-        LOG_ERROR( "the value of `type` member must be a string; cannot proceed" );
-        continue;
+    /* move `i` past the string starting at `i` */
+    inline bool skip_json_string( std::string_view json, size_t& i ) {
+      for ( i++; i < json.size(); i++ ) {
+        if ( json[i] == '\\' ) i++;
+        else if ( json[i] == '"' ) { i++; return true; }
       }
+      return false;
+    }
 
-      /* handle the type accordingly */
-      if ( type.GetString() == std::string( "Feature" ) ) {
-        /* the type of the object is feature */
+    /* Move `i` past the value starting at `i`. Only the nesting and the strings */
+    /* are looked at, the value itself is validated later by the parser.         */
+    inline bool skip_json_value( std::string_view json, size_t& i ) {
+      if ( i >= json.size() )
+        return false;
 
-        /* [TODO]: Handle features. */
-        /* check the `properties member` */
-        if ( !d[i].HasMember( "properties" ) ) {
-          LOG_ERROR( "a geojson object does not have a `properties` member; cannot proceed" );
-          continue;
-        }
+      if ( json[i] == '"' )
+        return skip_json_string( json, i );
 
-        /* get properties for this polygon */
-        properties props = process_properties( d[i]["properties"] );
+      if ( json[i] != '{' && json[i] != '[' ) {
+        /* scalar, ends at the next separator */
+        while ( i < json.size() && json[i] != ',' && json[i] != ']' && json[i] != '}' && !is_json_space( json[i] ) ) i++;
+        return true;
+      }
 
-        /* check the `geometry` member */
-        if ( !d[i].HasMember( "geometry" ) ) {
-          LOG_ERROR( "a geojson object does not have a `geometry` member; cannot proceed" );
+      uint32_t depth = 0;
+      while ( i < json.size() ) {
+        char c = json[i];
+        if ( c == '"' ) {
+          if ( !skip_json_string( json, i ) ) return false;
           continue;
         }
 
-        /* check the `type` of `geometry` */
-        if ( !d[i]["geometry"].HasMember( "type" ) ) {
-          LOG_ERROR( "a geojson object does not define the `type` of `geometry`; cannot proceed" );
-          continue;
+        if ( c == '{' || c == '[' ) depth++;
+        else if ( ( c == '}' || c == ']' ) && --depth == 0 ) { i++; return true; }
+        i++;
+      }
+
+      return false;
+    }
+
+    /* The members around the feature array are not parsed by the loader, */
+    /* so their values are checked to be valid json here.                 */
+    inline bool is_json_value( std::string_view value ) {
+      rapidjson::MemoryStream stream( value.data(), value.size() );
+      rapidjson::BaseReaderHandler<> handler;
+      rapidjson::Reader reader;
+      return !reader.Parse<rapidjson::kParseIterativeFlag>( stream, handler ).IsError();
+    }
+
+    /* move `i` past the key of the member starting at `i` and the colon after it */
+    inline bool skip_json_key( std::string_view json, size_t& i, std::string_view& key ) {
+      skip_json_space( json, i );
+      if ( i >= json.size() || json[i] != '"' )
+        return false;
+
+      size_t key_start = i;
+      if ( !skip_json_string( json, i ) )
+        return false;
+      key = json.substr( key_start + 1, i - key_start - 2 );
+
+      skip_json_space( json, i );
+      if ( i >= json.size() || json[i] != ':' )
+        return false;
+      i++;
+      skip_json_space( json, i );
+
+      return true;
+    }
+
+    /* move `i` past the value of a member of the root object other than `features` */
+    inline bool skip_root_member( std::string_view json, size_t& i, std::string_view key ) {
+      size_t start = i;
+      if ( !skip_json_value( json, i ) )
+        return false;
+
+      std::string_view value = json.substr( start, i - start );
+
+      /* other types of root objects are left to the parser */
+      if ( key == "type" && value != "\"FeatureCollection\"" )
+        return false;
+
+      return is_json_value( value );
+    }
+
+    /* Find the bytes of every element of the top level feature array, which is   */
+    /* either the root array or the `features` member of a `FeatureCollection`.   */
+    /* The rest of the file is checked as well, so that a file is only split if   */
+    /* the sequential parser would accept everything but the features too.        */
+    /* Returns false if the layout is not understood, the caller should then use  */
+    /* the sequential parser which reports the error properly.                    */
+    inline bool split_features( std::string_view json, std::vector<std::string_view>& features ) {
+      size_t i = 0;
+      skip_json_space( json, i );
+      if ( i >= json.size() )
+        return false;
+
+      /* find the `features` member in the root object */
+      bool root_array = json[i] == '[';
+      if ( !root_array ) {
+        if ( json[i] != '{' )
+          return false;
+        i++;
+
+        std::string_view key;
+        while ( true ) {
+          if ( !skip_json_key( json, i, key ) )
+            return false;
+
+          if ( key == "features" )
+            break;
+
+          if ( !skip_root_member( json, i, key ) )
+            return false;
+
+          skip_json_space( json, i );
+          if ( i >= json.size() || json[i] != ',' )
+            return false;
+          i++;
         }
-        
-        Value& geomerty_type = d[i]["geometry"]["type"];
-        if ( geomerty_type.GetType() != kStringType ) {
-          LOG_ERROR( "the geometry type is defined but the value is not a string; cannot proceed" );
-          continue;
+      }
+
+      /* the members after `features` and the end of the root object, */
+      /* nothing but spaces may follow the root value                 */
+      auto end_of_array = [&] () -> bool {
+        i++;
+        skip_json_space( json, i );
+
+        while ( !root_array ) {
+          if ( i >= json.size() )
+            return false;
+
+          if ( json[i] == '}' ) {
+            i++;
+            skip_json_space( json, i );
+            break;
+          }
+
+          if ( json[i] != ',' )
+            return false;
+          i++;
+
+          std::string_view key;
+          if ( !skip_json_key( json, i, key ) || key == "features" || !skip_root_member( json, i, key ) )
+            return false;
+
+          skip_json_space( json, i );
         }
 
-        if ( geomerty_type.GetString() == std::string( "MultiPolygon" ) ) {
-          auto geom = process_multi_polygon( d[i]["geometry"]["coordinates"] );
-          geom->set_props( props );
-          polygons.push_back( geom );
-        } else {
-          LOG_ERROR( "invalid `geometry` in geojson or geometry type not yet imeplemented: {}", geomerty_type.GetString() );
-          /* [TODO]: Handle other types. */
+        return i == json.size();
+      };
+
+      if ( i >= json.size() || json[i] != '[' )
+        return false;
+      i++;
+
+      skip_json_space( json, i );
+      if ( i < json.size() && json[i] == ']' )
+        return end_of_array();
+
+      while ( true ) {
+        skip_json_space( json, i );
+
+        size_t start = i;
+        if ( !skip_json_value( json, i ) )
+          return false;
+        features.push_back( json.substr( start, i - start ) );
+
+        skip_json_space( json, i );
+        if ( i >= json.size() )
+          return false;
+
+        if ( json[i] == ']' )
+          return end_of_array();
+        if ( json[i] != ',' )
+          return false;
+        i++;
+      }
+    }
+
+  }
+
+  /* Parse the geojson file on all the threads of the pool. The feature array is  */
+  /* split at the feature boundaries in batches of consecutive features, every    */
+  /* batch is parsed by one thread and `process` is called on the same thread     */
+  /* with the features and the attributes of the batch, so any heavy work on the  */
+  /* features is done in parallel as well. `batches` is filled in the order of    */
+  /* the file, merging them in order gives the same result as the sequential      */
+  /* loader, the rows of the attributes match the features. If `progress` is      */
+  /* given it counts the parsed features and the load stops when it is cancelled. */
+  /* Returns false if the file cannot be opened, is not a valid json or the load  */
+  /* is cancelled.                                                                */
+  template<typename T>
+  inline bool load_geojson_parallel( const string& filename, std::vector<T>& batches,
+                                     const std::function<void( std::vector<Ref<Geometry>>& features, AttributeTable& attributes, T& batch )>& process,
+                                     TaskProgress* progress = nullptr ) {
+    using namespace rapidjson;
+
+    batches.clear();
+
+    /* map the file */
+    DataFile file( filename, DataFile::Mode::Mapped );
+    if ( !file )
+      return false;
+
+    std::string_view json = file.view();
+
+    /* fall back to the sequential parser if the features cannot be separated */
+    std::vector<std::string_view> features;
+    if ( !detail::split_features( json, features ) ) {
+      std::vector<Ref<Geometry>> geometries;
+      AttributeTable attributes;
+      bool loaded = load_geojson( filename, attributes, [&] ( Ref<Geometry> geometry ) -> void {
+        geometries.push_back( geometry );
+      }, progress );
+
+      if ( !loaded )
+        return false;
+
+      batches.resize( 1 );
+      process( geometries, attributes, batches[0] );
+      return true;
+    }
+
+    /* batches of roughly equal size in bytes, enough of them for the */
+    /* threads to stay busy even if some features are much larger     */
+    ThreadPool* pool = ThreadPool::get();
+    size_t num_threads = pool ? pool->num_threads() + 1 : 1;
+    size_t batch_bytes = std::max<size_t>( json.size() / ( num_threads * 8 ), 1 << 18 );
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for ( size_t first = 0; first < features.size(); ) {
+      size_t last = first, bytes = 0;
+      while ( last < features.size() && ( last == first || bytes < batch_bytes ) )
+        bytes += features[last++].size();
+
+      ranges.push_back( std::make_pair( first, last ) );
+      first = last;
+    }
+
+    batches.resize( ranges.size() );
+    std::atomic<bool> failed = false;
+
+    if ( progress )
+      progress->total = features.size();
+
+    auto parse_batch = [&] ( size_t index ) -> void {
+      std::vector<Ref<Geometry>> geometries;
+      AttributeTable attributes;
+
+      GeoJSONHandler handler( [&] ( Ref<Geometry> geometry ) -> void {
+        geometries.push_back( geometry );
+      }, attributes );
+      Reader reader;
+
+      for ( size_t i = ranges[index].first; i < ranges[index].second && !failed; i++ ) {
+        handler.expect_features();
+
+        MemoryStream stream( features[i].data(), features[i].size() );
+        ParseResult result = reader.Parse<kParseIterativeFlag>( stream, handler );
+
+        if ( result.IsError() ) {
+          size_t offset = features[i].data() - json.data() + result.Offset();
+          LOG_ERROR( "failed to parse geojson file `{}`: {} (offset {})", filename, GetParseError_En( result.Code() ), offset );
+          failed = true;
         }
 
-      } else {
-        LOG_ERROR( "invalid `type` in geojson or type handler not yet implimented: {}", type.GetString() );
-        /* [TODO]: Handle other types. */
+        if ( progress ) {
+          progress->done++;
+          if ( progress->cancelled )
+            failed = true;
+        }
       }
 
+      if ( !failed )
+        process( geometries, attributes, batches[index] );
+    };
+
+    if ( pool )
+      pool->parallel_for( ranges.size(), parse_batch );
+    else
+      for ( size_t i = 0; i < ranges.size(); i++ ) parse_batch( i );
+
+    if ( failed ) {
+      batches.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+  inline std::vector<Ref<Geometry>> load_geojson_to_buffer( const string& filename, AttributeTable& attributes ) {
+    std::vector<Ref<Geometry>> polygons;
+
+    /* collect all the features in the file */
+    bool loaded = load_geojson( filename, attributes, [&] ( Ref<Geometry> geometry ) -> void {
+      polygons.push_back( geometry );
+    } );
+
+    /* ignore the file entirely if it has errors */
+    if ( !loaded ) {
+      attributes.clear();
+      return {};
     }
 
     /* return the vertex buffer */
@@ -18,162 +18,198 @@ namespace mv {
   /* repeat across different geometries                    */
   using vertex_index = uint32_t;
 
-  /* hash table of properties */
-  using properties = std::unordered_map<string, string>;
+  class Geometry;
+
+  /* Iterator over consecutive views of a container, e.g. the polygons of a */
+  /* geometry. The views are made on the fly and returned by value.          */
+  template<typename Owner, typename View, View ( Owner::*Get )( uint32_t ) const>
+  class ViewIterator {
+  public:
+    ViewIterator( const Owner* owner, uint32_t index ) : _owner( owner ), _index( index ) {}
+  public:
+    inline View operator*( void ) const { return ( _owner->*Get )( _index ); }
+    inline ViewIterator& operator++( void ) { _index++; return *this; }
+    inline bool operator==( const ViewIterator& other ) const { return _index == other._index; }
+    inline bool operator!=( const ViewIterator& other ) const { return _index != other._index; }
+  private:
+    const Owner* _owner;
+    uint32_t     _index;
+  };
 
   /* In a multi-polygon there are multiple polygons and each */
   /* polygon can have multiple sub polygons, for example a   */
   /* polygon with a cutout in between has one sub polygon.   */
+  /* This is a view of the positions of one sub-polygon in   */
+  /* the geometry, it is invalid once the geometry changes.  */
   class SubPolygon {
   public:
-    SubPolygon( void );
-    ~SubPolygon( void );
+    SubPolygon( const glm::dvec3* positions, uint32_t vertices ) : _positions( positions ), _vertices( vertices ) {}
   public:
-    /* update vertex at `index` */
-    void update( vertex_index index, const glm::vec3& position );
-
-    /* insert vertex after `offset` */
-    void insert( vertex_index offset, const glm::vec3& position );
-
-    /* push a vertex at the back of the list */
-    void push_back( const glm::vec3& position );
-
-    /* delete vertex at `index` */
-    void remove( vertex_index offset );
-
     /* return the position of vertex located at `index` */
-    glm::vec3 get_position( vertex_index index ) const;
+    glm::dvec3 get_position( vertex_index index ) const;
 
     /* return the number of vertices in the sub-polygon */
     inline uint32_t vertices( void ) const { return _vertices; }
 
-    /* Iterators to iterate over all the coordinates in the polygon, note */
-    /* that we do not have non-const iterator because we don't want these */
-    /* to be able to update positions, we have separate functions for     */
-    /* updating, inserting and deleting vertices.                         */
-    inline std::vector<glm::vec3>::const_iterator begin( void ) const { return _positions.begin(); }
-    inline std::vector<glm::vec3>::const_iterator end( void ) const { return _positions.end(); }
-
-    /* return the list of polygons */
-    inline const std::vector<glm::vec3>& positions( void ) const { return _positions; }
-
-    /* set the state of updated */
-    inline void set_updated( bool updated ) { _is_updated = updated; }
+    /* iterators to iterate over all the coordinates in the sub-polygon */
+    inline const glm::dvec3* begin( void ) const { return _positions; }
+    inline const glm::dvec3* end( void ) const { return _positions + _vertices; }
   private:
-    /* array to hold all the positions */
-    std::vector<glm::vec3> _positions;
-
-    /* number of vertices in the sub-polygon */
-    uint32_t _vertices = 0;
-
-    /* is the position updated, deleted, or is a new one added */
-    bool _is_updated = false;
+    const glm::dvec3* _positions;
+    uint32_t          _vertices;
   };
 
   /* A multi-polygon consist of multiple polygons, this class  */
   /* represent exactly that polygon. A polygon may or may not  */
   /* have more than one sub-polygons but is guarenteed to have */
-  /* one sub-polygon.                                          */
+  /* one sub-polygon. This is a view of the sub-polygons in    */
+  /* the geometry, it is invalid once the geometry changes.    */
   class Polygon {
   public:
-    Polygon( void );
-    ~Polygon( void );
+    Polygon( const Geometry* geometry, uint32_t first_ring, uint32_t last_ring ) :
+      _geometry( geometry ), _first_ring( first_ring ), _last_ring( last_ring ) {}
   public:
-    /* update vertex at `index`, remember here index is the  */
-    /* combined index of all the vertices in the sub-polygon */
-    void update( vertex_index index, const glm::vec3& position );
+    /* return the sub-polygon at `index` */
+    SubPolygon sub_polygon( uint32_t index ) const;
 
-    /* insert vertex after `offset` */
-    void insert( vertex_index offset, const glm::vec3& position );
+    using iterator = ViewIterator<Polygon, SubPolygon, &Polygon::sub_polygon>;
 
-    /* delete vertex at `index` */
-    void remove( vertex_index index );
-
-    /* push a entire sub-polygon at the back of the list */
-    void push_back( const SubPolygon& sub_polygon );
-
-    /* return the position of vertex located at `index` */
-    glm::vec3 get_position( vertex_index index ) const;
+    /* return the number of sub-polygons */
+    inline uint32_t sub_polygons( void ) const { return _last_ring - _first_ring; }
 
     /* return the combined number of vertices in all the sub-polygon */
-    inline uint32_t vertices( void ) const { return _vertices; }
+    uint32_t vertices( void ) const;
 
-    /* Iterators to iterate over all the sub-polygon in the polygon */
-    inline std::vector<SubPolygon>::const_iterator begin( void ) const { return _sub_polygons.begin(); }
-    inline std::vector<SubPolygon>::const_iterator end( void ) const { return _sub_polygons.end(); }
+    /* return the combined index of the first vertex of the polygon in the geometry */
+    vertex_index vertex_offset( void ) const;
 
-    /* return the list of all the sub-polygons */
-    inline const std::vector<SubPolygon>& sub_polygons( void ) const { return _sub_polygons; }
+    /* iterators to iterate over all the sub-polygon in the polygon */
+    inline iterator begin( void ) const { return iterator( this, 0 ); }
+    inline iterator end( void ) const { return iterator( this, sub_polygons() ); }
   private:
-    /* array of sub-polygons in the polygon */
-    std::vector<SubPolygon> _sub_polygons;
-
-    /* number of vertices in the polygon, this is the sum */
-    /* of vertices of all the sub-polygons                */
-    uint32_t _vertices = 0;
+    const Geometry* _geometry;
+    uint32_t        _first_ring;
+    uint32_t        _last_ring;
   };
 
+  /* A multi-polygon, all the positions of all the sub-polygons are kept in */
+  /* one array one sub-polygon after the other. The sub-polygons are found  */
+  /* with the offset of their first vertex and the polygons with the index  */
+  /* of their first sub-polygon, so a vertex is accessed directly with its  */
+  /* combined index and the sub-polygon of a vertex is a binary search.     */
   class Geometry : public SharedObject {
   public:
     Geometry( void );
     ~Geometry( void );
+
+    /* Make the geometry from arrays laid out as the ones below, every */
+    /* array is copied into one allocation of exactly its size.        */
+    Geometry( const std::vector<glm::dvec3>& positions, const std::vector<vertex_index>& ring_offsets, const std::vector<uint32_t>& polygon_offsets );
   public:
     /* update vertex at `index`, remember here index is the  */
     /* combined index of all the vertices in the polygons    */
-    void update( vertex_index index, const glm::vec3& position );
+    void update( vertex_index index, const glm::dvec3& position );
 
     /* insert vertex after `offset` */
-    void insert( vertex_index offset, const glm::vec3& position );
+    void insert( vertex_index offset, const glm::dvec3& position );
 
     /* delete vertex at `index` */
     void remove( vertex_index index );
 
-    /* push a entire polygon at the back of the list */
-    void push_back( const Polygon& polygon );
+    /* Add a sub-polygon with `count` positions to the polygon being built, */
+    /* the first sub-polygon of a polygon is its outer ring.                */
+    void push_sub_polygon( const glm::dvec3* positions, uint32_t count );
+
+    /* finish the polygon being built, it is dropped if it has no sub-polygons */
+    void end_polygon( void );
 
     /* return the position of vertex located at `index` */
-    glm::vec3 get_position( vertex_index index ) const;
+    glm::dvec3 get_position( vertex_index index ) const;
+
+    /* return the index of the sub-polygon with the vertex at `index` */
+    uint32_t sub_polygon_of( vertex_index index ) const;
+
+    /* return the index of the polygon with the vertex at `index` */
+    uint32_t polygon_of( vertex_index index ) const;
+
+    /* return the combined index of the first vertex of the sub-polygon at `ring` */
+    inline vertex_index sub_polygon_offset( uint32_t ring ) const { return _ring_offsets[ring]; }
+
+    /* return the polygon at `index` */
+    inline Polygon polygon( uint32_t index ) const { return Polygon( this, _polygon_offsets[index], _polygon_offsets[index + 1] ); }
+
+    /* return the number of polygons */
+    inline uint32_t polygons( void ) const { return (uint32_t)_polygon_offsets.size() - 1; }
+
+    using iterator = ViewIterator<Geometry, Polygon, &Geometry::polygon>;
 
     /* compute bounding box, it is not computed by default */
     void compute_bbox( void );
 
+    /* Is `point` inside any of the polygons, the sub-polygons of a polygon */
+    /* are tested together with the even-odd rule so the holes are outside. */
+    bool contains( const glm::dvec2& point ) const;
+
+    /* return the squared distance of `point` from the closest edge of any sub-polygon */
+    double outline_distance2( const glm::dvec2& point ) const;
+
+    /* The polygons edited since the last call to `clear_dirty`, in order. */
+    /* Only these have to be triangulated again.                           */
+    inline const std::vector<uint32_t>& dirty_polygons( void ) const { return _dirty_polygons; }
+    inline bool is_dirty( void ) const { return !_dirty_polygons.empty(); }
+    inline void clear_dirty( void ) { _dirty_polygons.clear(); }
+
     /* Iterators to iterate over all the polygon in the polygon */
-    inline std::vector<Polygon>::const_iterator begin( void ) const { return _polygons.begin(); }
-    inline std::vector<Polygon>::const_iterator end( void ) const { return _polygons.end(); }
+    inline iterator begin( void ) const { return iterator( this, 0 ); }
+    inline iterator end( void ) const { return iterator( this, polygons() ); }
 
     /* return the combined number of vertices in all the sub-polygon */
-    inline uint32_t vertices( void ) const { return _vertices; }
+    inline uint32_t vertices( void ) const { return (uint32_t)_positions.size(); }
+
+    /* return the positions of all the vertices */
+    inline const std::vector<glm::dvec3>& positions( void ) const { return _positions; }
 
     /* return the bounding box for the geometry */
     inline Box bbox( void ) const { return _bounding_box; }
 
+    /* set the bounding box when it is already known, e.g. read from a cache */
+    inline void set_bbox( const Box& box ) { _bounding_box = box; }
+
     /* return the unique id allocated for the polygon */
     inline polygon_id id( void ) const { return _id; }
 
-    /* set and get properties */
-    inline const properties& get_props( void ) const { return _properties; }
-    inline void set_props( properties props ) { _properties = props; }
-
     /* Do not use this function to set id, it is called by map layer to track */
     /* the polygon internally. Setting ids manually will result in undefined  */
     /* behaviour and may even crash the program.                              */
     inline void set_id( polygon_id id ) { _id = id; }
   private:
-    /* array of polygons in the geometry */
-    std::vector<Polygon> _polygons;
+    friend class Polygon;
+
+    /* return the index of the polygon with the sub-polygon at `ring` */
+    uint32_t polygon_of_sub_polygon( uint32_t ring ) const;
 
-    /* number of vertices in the geometry, this is the sum */
-    /* of vertices of all the polygons.                    */
-    uint32_t _vertices = 0;
+    /* add `polygon` to the edited polygons */
+    void mark_dirty( uint32_t polygon );
+
+    /* positions of all the sub-polygons one after the other */
+    std::vector<glm::dvec3> _positions;
+
+    /* offset of the first vertex of every sub-polygon, followed by the */
+    /* number of vertices                                               */
+    std::vector<vertex_index> _ring_offsets = { 0 };
+
+    /* index of the first sub-polygon of every polygon, followed by the  */
+    /* number of sub-polygons in finished polygons                       */
+    std::vector<uint32_t> _polygon_offsets = { 0 };
+
+    /* sorted indices of the edited polygons */
+    std::vector<uint32_t> _dirty_polygons;
 
     /* unique id for the geometry */
     polygon_id _id;
 
     /* bounding box of the geometry */
     Box _bounding_box;
-
-    /* properties of the current geometry */
-    properties _properties;
   };
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <utils/singleton.h>
 
 #include <graphics/buffers.h>
@@ -13,12 +15,31 @@
 
 namespace mv {
 
+  /* vertices of a section of the buffer to start with */
   #define MAX_VERTICES 262144 /* 4096 * 64 */
 
   /* Immgfx is short of immediate mode gfx, the renderer build */
   /* vertex data each frame and draw them together.            */
+  /*                                                           */
+  /* The vertices of a batch are gathered in memory and copied */
+  /* to a buffer which stays mapped when the batch is drawn,   */
+  /* the mapping is only ever written. The buffer is split in  */
+  /* `SECTIONS` sections used one after the other. The batches */
+  /* follow each other in a section, when one does not fit the */
+  /* section is fenced and the batch goes to the next one once */
+  /* the GPU is done with it. A batch larger than a section    */
+  /* makes all of them grow.                                   */
   class Immgfx : public Singleton<Immgfx> {
     REGISTER_SINGLETON_CLASS( Immgfx );
+  public:
+    /* vertex as it is written to the buffer */
+    struct Vertex {
+      glm::vec3 position;
+      glm::vec4 color;
+    };
+
+    /* sections of the buffer, the GPU reads from the ones behind the one being written */
+    static constexpr uint32_t SECTIONS = 3;
   protected:
     Immgfx( void );
     ~Immgfx( void );
@@ -29,7 +50,7 @@ namespace mv {
     /* unbind the framebuffer and tranfer it's color data to screen */
     void unbind( void );
 
-    /* begin drawing, this simple map the vertex buffer */
+    /* begin a batch of vertices */
     void begin( void );
 
     /* draw the submitted vertices with the camera and topology */
@@ -41,6 +62,9 @@ namespace mv {
     /* submit vertex to the renderer */
     void push_vertex( glm::vec3 position, glm::vec4 color );
 
+    /* submit `count` vertices to the renderer at once */
+    void push_vertices( const Vertex* vertices, size_t count );
+
     /* after draw you can call this to get primitve id at x, y */
     uint32_t get_primitive_id( uint32_t x, uint32_t y );
 
@@ -49,6 +73,12 @@ namespace mv {
 
     /* return the color attachment */
     inline Ref<Texture2D> color_attachment( void ) const { return _color_attachment; }
+  private:
+    /* make room for `count` vertices in one section, returns the first one */
+    size_t reserve( size_t count );
+
+    /* replace the buffer with one whose sections hold at least `section_size` vertices */
+    void grow( size_t section_size );
   private:
     Ref<Shader> _shader;
 
@@ -58,7 +88,18 @@ namespace mv {
     Ref<Texture2D>   _color_attachment;
     Ref<Texture2D>   _primitive_id_attachment;
 
-    size_t _vertex_index = 0;
+    /* vertices in a section and the section being written */
+    size_t   _section_size = MAX_VERTICES;
+    uint32_t _section      = 0;
+
+    /* next vertex to write in the buffer */
+    size_t _head = 0;
+
+    /* vertices pushed since the batch began */
+    std::vector<Vertex> _batch;
+
+    /* fence after the last draw from every section, null once waited for */
+    void* _fences[SECTIONS] = {};
   };
 
 }
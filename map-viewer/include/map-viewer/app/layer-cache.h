@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <types.h>
+
+#include <utils/file-reader.h>
+
+namespace mv {
+
+  /* On-disk cache of a map layer, stored next to the source file as     */
+  /* `<source>.mvcache`. The cache is a header followed by raw arrays,   */
+  /* every array is aligned so that it can be used directly from the     */
+  /* mapped file without copying. The cache is only valid for the size   */
+  /* and modification time of the source recorded in the header, and     */
+  /* for the version below, which must be bumped whenever the layout of  */
+  /* any of the arrays changes.                                          */
+  class LayerCache {
+  public:
+    static constexpr uint32_t VERSION = 10;
+
+    /* the arrays in the cache, the meaning of each is decided by the map layer */
+    enum class Section : uint32_t {
+      Vertices,
+      TriangleIndices,
+      OutlineIndices,
+      BufferRanges,
+      PolygonBufferSizes,
+      LodTolerances,
+      LodRanges,
+      BoundingBoxes,
+      GeometryPolygons,
+      PolygonSubPolygons,
+      SubPolygonVertices,
+      Positions,
+      AttributeNameOffsets,
+      AttributeNames,
+      AttributeDictionarySizes,
+      AttributeTypes,
+      AttributeValues,
+      AttributeStringOffsets,
+      AttributeStrings,
+      Count
+    };
+  public:
+    LayerCache( void );
+    ~LayerCache( void );
+  public:
+    /* Map the cache for `source`, returns false if there is no cache or */
+    /* if it is stale or from another version.                           */
+    bool open( const string& source );
+
+    /* return the array stored in `section`, `count` is set to the number of `T`s */
+    template<typename T>
+    inline const T* get( Section section, size_t& count ) const {
+      const auto& entry = _sections[(size_t)section];
+      count = entry.second / sizeof( T );
+      return reinterpret_cast<const T*>( entry.first );
+    }
+
+    /* set the array written to `section` by `write`, the data is not copied */
+    template<typename T>
+    inline void set( Section section, const T* data, size_t count ) {
+      _sections[(size_t)section] = std::make_pair( reinterpret_cast<const char*>( data ), count * sizeof( T ) );
+    }
+
+    /* write all the sections for `source`, returns false on failure */
+    bool write( const string& source ) const;
+
+    /* return the path of the cache for `source` */
+    static string cache_path( const string& source );
+  private:
+    /* bytes of every section, either in the mapped file or set by the caller */
+    std::array<std::pair<const char*, size_t>, (size_t)Section::Count> _sections;
+
+    /* mapped cache file */
+    DataFile _file;
+  };
+
+}
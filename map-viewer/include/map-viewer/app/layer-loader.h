@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <types.h>
+#include <utils/ref.h>
+#include <core/thread-pool.h>
+
+#include <app/map-layer.h>
+
+namespace mv {
+
+  /* Load a map layer in the background. The file is parsed and triangulated */
+  /* on the thread pool while the UI keeps running, after that `update` has  */
+  /* to be called every frame on the GL thread to upload the vertices in     */
+  /* chunks. The layer can be drawn as soon as the parsing is done, it fills */
+  /* in while uploading.                                                     */
+  class LayerLoader : public SharedObject {
+  public:
+    enum class Stage {
+      Parsing,
+      Uploading,
+      Done,
+      Failed,
+      Cancelled
+    };
+  public:
+    LayerLoader( const string& filename );
+
+    /* cancel the load if it is not done */
+    ~LayerLoader( void );
+  public:
+    /* Advance the load, once parsed at most `budget` bytes are uploaded per */
+    /* call. Must be called on the GL thread, returns the current stage.     */
+    Stage update( size_t budget );
+
+    /* stop the load, the layer is released */
+    void cancel( void );
+
+    /* completed fraction of the current stage in [0, 1] */
+    float progress( void ) const;
+
+    /* the loaded layer, only valid from `Stage::Uploading` onwards */
+    inline Ref<MapLayer> layer( void ) const { return _layer; }
+
+    inline Stage stage( void ) const { return _stage; }
+    inline const string& filename( void ) const { return _filename; }
+  private:
+    /* Shared with the task on the thread pool, which may still be running  */
+    /* after the loader is gone. The task hands over the layer under the    */
+    /* mutex unless the load was cancelled, in which case it deletes it.    */
+    /* The reference counts of `Ref` are not atomic, so the layer and the   */
+    /* geometries in it must only be used by one thread at a time. The task */
+    /* keeps no `Ref` to them once the layer is built and passes it as a    */
+    /* raw pointer, the mutex orders its last access before the first one   */
+    /* of the GL thread. Nothing else may cross threads without the mutex.  */
+    struct State {
+      string       filename;
+      TaskProgress progress;
+      std::mutex   mutex;
+      bool         finished = false;
+      MapLayer*    layer    = nullptr;
+    };
+  private:
+    string _filename;
+    Stage  _stage = Stage::Parsing;
+
+    std::shared_ptr<State> _state;
+    Ref<MapLayer>          _layer;
+  };
+
+}
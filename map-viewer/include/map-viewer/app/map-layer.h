@@ -2,34 +2,141 @@
 
 #include <list>
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include <types.h>
 
 #include <utils/ref.h>
+#include <core/thread-pool.h>
 #include <graphics/buffers.h>
+#include <graphics/renderstate.h>
 
 #include <app/geometry.h>
+#include <app/attribute-table.h>
+#include <app/triangulator.h>
+#include <app/packed-rtree.h>
+#include <app/block-allocator.h>
 
 namespace mv {
 
+  class LayerCache;
+
+  /* glsl vertex attribute, the position as a cell of the grid of the layer */
+  struct GridPosition2 {
+    static VertexDataType attribute_type( void ) { return VertexDataType::Int2; }
+    static string attribute_name( void ) { return "a_position"; }
+    int32_t data[2];
+  };
+
   /* glsl vertex attribute, this one represent polygon id */
-  /* only one component is used for now so I may remove   */
-  /* the other later.                                     */
   struct PolygonIDAttribute {
-    static VertexDataType attribute_type( void ) { return VertexDataType::UInt2; }
+    static VertexDataType attribute_type( void ) { return VertexDataType::UInt; }
     static string attribute_name( void ) { return "a_id"; }
-    uint32_t data[2];
+    uint32_t data[1];
+  };
+
+  /* Uniforms of a layer for the shader drawing it, in the std140 layout */
+  /* of its `Layer` block. The padding is zeroed so that the uniforms    */
+  /* can be compared as bytes.                                           */
+  struct LayerUniforms {
+    glm::ivec2 eye_cell   = glm::ivec2( 0 );
+    glm::vec2  eye_offset = glm::vec2( 0.0f );
+    glm::vec4  fill_color = glm::vec4( 0.0f );
+    glm::vec4  line_color = glm::vec4( 0.0f );
+    float      grid_step  = 0.0f;
+    float      padding[3] = {};
   };
 
   /* Map layer is a data structure to hold all the polygons in a */
   /* geojson file.  */
   class MapLayer : public SharedObject {
+    /* The positions are the cells of the grid of the layer, see `to_grid`. */
+    /* Every position of a geometry is one vertex shared by the triangles   */
+    /* and the outlines which refer to it by index.                         */
     struct Vertex {
-      glm::vec3  position;
-      glm::uvec2 polygon_id;
+      glm::ivec2 position;
+      polygon_id id;
+    };
+
+    /* number of triangle and outline indices of one polygon of a geometry */
+    struct PolygonBufferSize {
+      uint32_t triangles;
+      uint32_t outlines;
+    };
+
+    /* range of one geometry in the vertex and index buffers, stored as is in the cache */
+    struct BufferRange {
+      uint64_t vertex_offset;
+      uint64_t triangle_offset;
+      uint64_t outline_offset;
+      uint64_t vertices;
+      uint64_t triangles;
+      uint64_t outlines;
+    };
+
+    /* range of one geometry in the index buffers at one simplified level, stored as is in the cache */
+    struct IndexRange {
+      uint64_t triangle_offset;
+      uint64_t outline_offset;
+      uint64_t triangles;
+      uint64_t outlines;
+    };
+
+    /* features of the file processed by one thread while loading, the */
+    /* indices and the offsets of the ranges are relative to the batch */
+    struct LoadBatch {
+      std::vector<Ref<Geometry>>     geometries;
+      size_t                         vertices = 0;
+      std::vector<uint32_t>          triangles;
+      std::vector<uint32_t>          outlines;
+      std::vector<BufferRange>       ranges;
+      std::vector<PolygonBufferSize> polygon_sizes;
+      AttributeTable                 attributes;
+      TriangulationStats             triangulation;
+    };
+  public:
+    /* Number of simplified levels of detail kept after the full resolution, */
+    /* every level allows `LOD_LEVEL_FACTOR` times the error of the one      */
+    /* before it. The first one allows `LOD_FIRST_TOLERANCE` of the largest  */
+    /* side of the layer.                                                    */
+    static constexpr uint32_t LOD_LEVELS          = 6;
+    static constexpr double   LOD_LEVEL_FACTOR    = 4.0;
+    static constexpr double   LOD_FIRST_TOLERANCE = 1.0 / 16384.0;
+
+    /* The positions are stored on a grid centered on the layer, its step is  */
+    /* the power of two which fits the largest side of the layer in a quarter */
+    /* of `GRID_CELLS`. The cells of the vertices are clamped to `GRID_LIMIT` */
+    /* on either side, so an edit can go out as far as half of the layer      */
+    /* again before it sticks. The eye is clamped one cell less, so that the  */
+    /* difference with the cell of a vertex always fits in an int.            */
+    static constexpr double GRID_CELLS = 4294967296.0;
+    static constexpr double GRID_LIMIT = GRID_CELLS / 4.0;
+
+    /* error of a drawn level in pixels */
+    static constexpr double LOD_PIXEL_TOLERANCE = 0.5;
+
+    /* Level of the nodes of the index which are culled and drawn as one   */
+    /* range, a node of level 1 holds `PackedRTree::NODE_SIZE` geometries. */
+    static constexpr uint32_t CHUNK_LEVEL = 1;
+
+    /* The index buffers are compacted after an edit once their free */
+    /* blocks make up this part of them.                             */
+    static constexpr double COMPACT_FREE_FRACTION = 0.25;
+  private:
+    /* indices of the simplified levels of some geometries, the ranges are relative to the vectors */
+    struct LodBuffers {
+      std::vector<uint32_t>   triangles[LOD_LEVELS];
+      std::vector<uint32_t>   outlines[LOD_LEVELS];
+      std::vector<IndexRange> ranges[LOD_LEVELS];
     };
   public:
+    /* load the layer, the GPU buffers are ready when this returns */
     MapLayer( const string& filename );
+
+    /* Load only the CPU side of the layer, OpenGL is not touched so this can */
+    /* run on any thread. The vertices are kept until `upload` sends them to  */
+    /* the GPU on the GL thread. `progress` may be null.                      */
+    MapLayer( const string& filename, TaskProgress* progress );
     ~MapLayer( void );
   public:
     /* select the geometry with `id` */
@@ -56,22 +163,116 @@ namespace mv {
     /* return the geometry with `id` */
     Ref<Geometry> get_geometry( polygon_id id ) const;
 
-    /* return the bounding box for the layer */
-    Box bounding_box( void ) const;
-
-    /* update the geometry with `id`, call this after editing geometry */
+    /* return the attributes of all the geometries */
+    inline const AttributeTable& attributes( void ) const { return _attributes; }
+
+    /* return the row of the attributes for the geometry with `id` */
+    inline size_t attribute_row( polygon_id id ) const { return id - 1; }
+
+    /* return the bounding box for the layer, kept up to date with the edits */
+    inline Box bounding_box( void ) const { return _bounding_box; }
+
+    /* return the ids of the geometries whose bounding box overlaps `box` */
+    std::vector<polygon_id> query( const Box& box ) const;
+
+    /* return the ids of the geometries whose bounding box contains `point` */
+    std::vector<polygon_id> query( const glm::dvec2& point ) const;
+
+    /* Return the ids of the geometries under `point`. A geometry is under */
+    /* the point if it is drawn filled and contains the point, or if the   */
+    /* point is within `tolerance` of its outline.                         */
+    std::vector<polygon_id> pick( const glm::dvec2& point, double tolerance ) const;
+
+    /* rings triangulated by each path while loading the source, zero if the layer came from the cache */
+    inline const TriangulationStats& triangulation_stats( void ) const { return _triangulation_stats; }
+
+    /* Upload at most `budget` bytes of the loaded vertices to the GPU, must */
+    /* be called on the GL thread. Returns true once everything is uploaded. */
+    bool upload( size_t budget );
+
+    /* weather all the vertices and indices are on the GPU */
+    inline bool is_uploaded( void ) const {
+      return _uploaded_vertices == _num_staged_vertices && _uploaded_triangles == _num_staged_triangles && _uploaded_outlines == _num_staged_outlines;
+    }
+
+    /* fraction of the vertices and indices on the GPU */
+    inline float upload_progress( void ) const {
+      size_t total = _num_staged_vertices * sizeof( Vertex ) + ( _num_staged_triangles + _num_staged_outlines ) * sizeof( uint32_t );
+      size_t done = _uploaded_vertices * sizeof( Vertex ) + ( _uploaded_triangles + _uploaded_outlines ) * sizeof( uint32_t );
+      return total > 0 ? (float)done / (float)total : 1.0f;
+    }
+
+    /* Level of detail to draw when one pixel covers `world_per_pixel`, the */
+    /* coarsest level whose error is within `LOD_PIXEL_TOLERANCE` pixels.   */
+    /* Level 0 is the full resolution.                                      */
+    uint32_t lod_level( double world_per_pixel ) const;
+
+    /* return the number of levels, the full resolution and the simplified ones */
+    inline uint32_t lod_levels( void ) const { return 1 + (uint32_t)_lod_tolerances.size(); }
+
+    /* Offset and number of the triangle and outline indices of `level` that */
+    /* can be drawn while the layer is uploading. The indices can only be    */
+    /* drawn once all the vertices are uploaded, the simplified levels are   */
+    /* uploaded after the full one which is drawn as far as it is uploaded   */
+    /* until then. Once uploaded the edits move the geometries out of the    */
+    /* ranges, `visible_ranges` follows them.                                */
+    std::tuple<size_t, size_t> drawable_triangles( uint32_t level ) const;
+    std::tuple<size_t, size_t> drawable_outlines( uint32_t level ) const;
+
+    /* Replace `triangles` and `outlines` with the ranges of `level` to draw  */
+    /* to cover `view`. The geometries are laid out in the order of the index */
+    /* so that every chunk of nearby geometries is one range, neighbouring    */
+    /* ranges are merged into one. The chunks with an edited geometry are     */
+    /* drawn geometry by geometry until the layer is compacted.               */
+    void visible_ranges( uint32_t level, const Box& view, DrawRanges& triangles, DrawRanges& outlines ) const;
+
+    /* Update the geometry with `id`, call this after editing geometry. The */
+    /* geometry is written over its blocks in the buffers, or to new blocks */
+    /* if it grew, the other geometries do not move.                        */
     void update( polygon_id id );
 
+    /* Build the simplified levels of the geometries updated since the last  */
+    /* call again, `update` only builds the full resolution. Must be called  */
+    /* before a simplified level is drawn.                                   */
+    void update_lods( void );
+
+    /* Lay the indices of all the levels out in the order of the index again */
+    /* and drop the free blocks left by the edits, the vertices stay.        */
+    void compact( void );
+
+    /* return how the elements of the vertex and index buffers are used by the geometries */
+    inline BlockAllocator::Stats vertex_block_stats( void ) const { return _vertex_blocks.stats(); }
+    inline BlockAllocator::Stats triangle_block_stats( void ) const { return _triangle_blocks.stats(); }
+    inline BlockAllocator::Stats outline_block_stats( void ) const { return _outline_blocks.stats(); }
+
+    /* return the offset and the number of the full resolution outline indices of the geometry with `id` */
     std::tuple<uint32_t, uint32_t> get_outline_indices( polygon_id id ) const;
 
     /* is the layer empty */
     inline bool empty( void ) const { return _geometries.empty(); }
 
-    /* return the vertex buffer */
-    inline Ref<VertexBuffer<Position3, PolygonIDAttribute>> vertex_buffer( void ) const { return _consolidated_vertices; }
+    /* return the vertex buffer, shared by the triangles and the outlines */
+    inline Ref<VertexBuffer<GridPosition2, PolygonIDAttribute>> vertex_buffer( void ) const { return _vertices; }
+
+    /* Return the cell of the grid of the vertices closest to `position` and   */
+    /* the offset of `position` from it in cells. The vertices are drawn       */
+    /* relative to the camera from the difference of the cells, which is exact */
+    /* in integers, and the offset.                                            */
+    void to_grid( const glm::dvec3& position, glm::ivec2& cell, glm::vec2& offset ) const;
+
+    /* return the distance between two cells of the grid in the units of the positions */
+    inline double grid_step( void ) const { return _grid_step; }
+
+    /* Return the uniform buffer of the layer drawn from `eye`, it is */
+    /* only written when the eye or the colors changed since the last */
+    /* call. Must be called on the thread of the OpenGL context.      */
+    Ref<UniformBuffer<LayerUniforms>> update_uniforms( const glm::dvec3& eye );
 
-    /* return the outline buffer */
-    inline Ref<VertexBuffer<Position3>> outline_buffer( void ) const { return _consolidated_outlines; }
+    /* return the triangle indices of all the levels one after the other, drawn as a list of triangles */
+    inline Ref<IndexBuffer> triangle_buffer( void ) const { return _triangles; }
+
+    /* return the outline indices of all the levels one after the other, drawn as line strips with a restart after every ring */
+    inline Ref<IndexBuffer> outline_buffer( void ) const { return _outlines; }
 
     /* return the name */
     inline string name( void ) const { return _layer_name; }
@@ -112,30 +313,152 @@ namespace mv {
     /* get the geometries vector */
     inline std::vector<Ref<Geometry>>& get_geometries( void ) { return _geometries; }
   private:
-    /* return the triangulated vertex positions for the geometry */
-    std::vector<Vertex> make_polygon_buffer( Ref<Geometry> geometry );
+    /* parse and triangulate the source file, the cache is written afterwards */
+    void load_source( const string& filename, TaskProgress* progress );
+
+    /* load everything from the cache of the source file, returns false   */
+    /* if there is no valid cache for the file or `progress` is cancelled */
+    bool load_cache( const string& filename, TaskProgress* progress );
+
+    /* write the cache for the source file */
+    void write_cache( const string& filename, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& outlines ) const;
+
+    /* append a vertex for every position of the geometry to `vertices` */
+    void make_vertex_buffer( Ref<Geometry> geometry, std::vector<Vertex>& vertices );
+
+    /* Append the triangle indices and the outline strips of `polygon` in  */
+    /* the geometry, the first vertex of the geometry is at `base_vertex`. */
+    void make_index_buffers( Ref<Geometry> geometry, uint32_t polygon, uint32_t base_vertex, std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines );
+
+    /* Append the indices of the geometry at every simplified level to `lods`, */
+    /* the first vertex of the geometry is at `base_vertex`.                   */
+    void make_lod_buffers( Ref<Geometry> geometry, uint32_t base_vertex, LodBuffers& lods );
+
+    /* Simplify all the geometries and append the indices of the levels after */
+    /* the full resolution indices in `triangles` and `outlines`.             */
+    void build_lods( std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines );
+
+    /* range of the indices of the whole `level` in the index buffers as laid out by `layout_ranges` */
+    IndexRange level_range( uint32_t level ) const;
+
+    /* range of the indices of `geometry` at `level` */
+    IndexRange geometry_range( uint32_t level, uint32_t geometry ) const;
+
+    /* compact the buffers if the edits left too many free blocks, at the end of an edit */
+    void finish_edit( void );
+
+    /* lay the ranges of all the levels out one after the other again */
+    void layout_ranges( void );
+
+    /* start the blocks of the index buffers over as laid out, nothing free and no chunk moved */
+    void reset_index_blocks( void );
 
-    /* return the connected outline positions for the geometry */
-    std::vector<glm::vec3> make_outline_buffer( Ref<Geometry> geometry );
+    /* return the number of geometries in a chunk */
+    uint32_t chunk_size( void ) const;
 
-    /* triangulate a geometry and return the vertices */
-    std::vector<vertex_index> triangulate( Ref<Geometry> geometry );
+    /* build the index and the extent of the layer over the bounding boxes of the geometries */
+    void build_index( void );
+
+    /* update the extent of the layer after the box of a geometry changed from `old_box` to `new_box` */
+    void update_extent( const Box& old_box, const Box& new_box );
+
+    /* set the grid of the vertices from the extent of the layer */
+    void build_grid( void );
+
+    /* return the cell of the grid of `position`, clamped to `GRID_LIMIT` */
+    glm::ivec2 grid_cell( const glm::dvec3& position ) const;
+
+    /* Append the vertices of all the geometries to `vertices` and move the  */
+    /* full resolution indices, both in the order of the leaves of the index */
+    void arrange( std::vector<Vertex>& vertices, std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines );
   private:
     /* hash map for all the geometries in the layer */
     std::vector<Ref<Geometry>> _geometries;
 
-    /* selected polygons in the geometry */
-    std::vector<polygon_id> _selected_geometries;
+    /* attributes of the geometries, the row `id - 1` belongs to the geometry with `id` */
+    AttributeTable _attributes;
 
-    /* size and offset occupied by each geometry in the below vertex buffers */
-    std::vector<std::pair<size_t, size_t>> _buffer_sizes;
-    std::vector<std::pair<size_t, size_t>> _buffer_offsets;
+    /* Spatial index over the bounding boxes of the geometries, the item */
+    /* `id - 1` is the geometry with `id`. The geometries are in the     */
+    /* buffers in the order of its leaves at every level.                */
+    PackedRTree _index;
 
-    /* single vertex buffer for all the vertices, also this is triangulated */
-    Ref<VertexBuffer<Position3, PolygonIDAttribute>> _consolidated_vertices;
+    /* union of the bounding boxes of the geometries */
+    Box _bounding_box;
+
+    /* position of the cell 0 and distance between two cells of the grid of  */
+    /* the vertices, fixed once loaded so that edits keep the other vertices */
+    glm::dvec2 _grid_origin = glm::dvec2( 0.0 );
+    double     _grid_step   = 1.0;
+
+    /* chunks found by the last `visible_ranges` */
+    mutable std::vector<uint32_t> _visible_chunks;
+
+    /* selected polygons in the geometry */
+    std::vector<polygon_id> _selected_geometries;
 
-    /* single vertex buffer for all the outlines */
-    Ref<VertexBuffer<Position3>> _consolidated_outlines;
+    /* range occupied by each geometry in the below buffers */
+    std::vector<BufferRange> _buffer_ranges;
+
+    /* Size of every polygon of every geometry in the buffers, the polygons  */
+    /* of a geometry are one after the other from its first polygon. An edit */
+    /* only rebuilds the polygons that changed using these.                  */
+    std::vector<PolygonBufferSize> _polygon_buffer_sizes;
+    std::vector<uint32_t>          _first_polygon;
+
+    TriangulationStats _triangulation_stats;
+
+    /* Error allowed in every simplified level in the units of the positions, */
+    /* and the range of every geometry at every level, level after level.     */
+    /* The levels share the vertices of the full resolution.                  */
+    std::vector<double>     _lod_tolerances;
+    std::vector<IndexRange> _lod_ranges;
+
+    /* ids of the updated geometries whose simplified levels are out of date */
+    std::vector<polygon_id> _stale_lods;
+
+    /* Single vertex buffer for all the positions of all the geometries. The */
+    /* vertices of an edited geometry which grew move to a free block.       */
+    Ref<VertexBuffer<GridPosition2, PolygonIDAttribute>> _vertices;
+
+    /* single index buffer for all the triangles of all the levels */
+    Ref<IndexBuffer> _triangles;
+
+    /* single index buffer for all the outlines of all the levels */
+    Ref<IndexBuffer> _outlines;
+
+    /* uniforms of the last draw, created by the first one */
+    Ref<UniformBuffer<LayerUniforms>> _uniforms;
+
+    /* Blocks of the geometries in the buffers above. Every range of a */
+    /* geometry is a block which an edit writes over, shrinks or moves */
+    /* to a free block when it grows.                                  */
+    BlockAllocator _vertex_blocks;
+    BlockAllocator _triangle_blocks;
+    BlockAllocator _outline_blocks;
+
+    /* Weather a geometry of a chunk moved or changed its size at a level, */
+    /* chunk after chunk level after level. The geometries of a chunk are  */
+    /* one range at a level until then.                                    */
+    std::vector<uint8_t> _moved_chunks;
+
+    /* Vertices and indices waiting to be uploaded, they live either in the */
+    /* storage below or in the mapped cache and are released after upload.  */
+    const Vertex*               _staged_vertices      = nullptr;
+    const uint32_t*             _staged_triangles     = nullptr;
+    const uint32_t*             _staged_outlines      = nullptr;
+    size_t                      _num_staged_vertices  = 0;
+    size_t                      _num_staged_triangles = 0;
+    size_t                      _num_staged_outlines  = 0;
+    std::vector<Vertex>         _staged_vertex_storage;
+    std::vector<uint32_t>       _staged_triangle_storage;
+    std::vector<uint32_t>       _staged_outline_storage;
+    std::unique_ptr<LayerCache> _staged_cache;
+
+    /* number of vertices and indices already uploaded */
+    size_t _uploaded_vertices  = 0;
+    size_t _uploaded_triangles = 0;
+    size_t _uploaded_outlines  = 0;
 
     /* name of the layer */
     string _layer_name;
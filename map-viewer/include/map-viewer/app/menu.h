@@ -10,6 +10,7 @@
 #include <app/ortho-camera.h>
 #include <app/editor-layer.h>
 #include <app/map-layer.h>
+#include <app/layer-loader.h>
 
 #include <graphics/textures.h>
 #include <tools/contentbrowser.h>
@@ -21,8 +22,10 @@ namespace mv {
     ApplicationMenu( void );
     ~ApplicationMenu( void );
   public:
+    /* advances the layer loaders, they must run every frame even if the layer menu is closed */
+    virtual void update( float delta_time ) override;
+
     /* use these functions if required */
-    virtual void update( float delta_time ) override {}
     virtual void on_event( Event& e ) override {}
 
     /* imgui render function, put functions here, this is called after ImGui::BeginFrame */
@@ -48,11 +51,16 @@ namespace mv {
     void draw_menubar( void );
     void draw_viewport( void );
     void draw_layer_menu( void );
+    void update_layer_loaders( void );
+    void draw_layer_loaders( void );
     void draw_renderstate_menu( void );
 
     void draw_attributes( Ref<MapLayer> selected_layer );
     void draw_attibutes_menu( Ref<MapLayer> selected_layer );
     void draw_filter_menu( Ref<MapLayer> selected_layer );
+
+    /* sort the filtered polygons by the columns in `sort_specs` */
+    void sort_attributes( Ref<MapLayer> selected_layer, const ImGuiTableSortSpecs* sort_specs );
   private:
     bool _show_menus = true;
     bool _show_demo_window = false;
@@ -70,6 +78,7 @@ namespace mv {
     glm::ivec2 _viewport_position = { 0, 0 };
     Ref<Texture2D> _viewport_texture = nullptr;
     std::vector<Ref<MapLayer>>* _map_layers = nullptr;
+    std::vector<Ref<LayerLoader>> _layer_loaders;
     Ref<MapLayer> _selected_layer = nullptr;
     Ref<EditorLayer> _editor_layer = nullptr;
     Ref<OrthoCamera> _camera = nullptr;
@@ -86,5 +95,6 @@ namespace mv {
     std::vector<polygon_id> _filtered_polygons;
     std::future<void> _filter_future;
     bool _refilter_attributes = true;
+    bool _resort_attributes = true;
   };
 }
@@ -31,8 +31,17 @@ namespace mv {
 
     /* return the camera view matrix */
     virtual glm::mat4 view( void ) const override {
+      return view( glm::dvec3( 0.0 ) );
+    }
+
+    /* Return the view matrix for positions given relative to `origin`, the */
+    /* offset from the origin is computed in double so that the matrix is   */
+    /* precise as long as the positions are close to the origin.            */
+    glm::mat4 view( const glm::dvec3& origin ) const {
+      glm::dvec3 offset = glm::dvec3( _position.x, _position.y, 0.0 ) - glm::dvec3( origin.x, origin.y, 0.0 );
+
       glm::mat4 view = glm::mat4( 1.0f );
-      view = glm::translate( view, glm::vec3( -_position.x, -_position.y, 0.0f ) );
+      view = glm::translate( view, -glm::vec3( offset ) );
       return view;
     }
 
@@ -43,7 +52,7 @@ namespace mv {
       glm::vec2 mouse_pos_delta = Input::mouse_position_delta();
 
       if ( Input::is_mouse_button_down( MOUSE_BUTTON_MIDDLE ) ) {
-        float factor = _position.z * _mouse_move_sensitivity;
+        double factor = _position.z * _mouse_move_sensitivity;
 
         _target.x += -mouse_pos_delta.x * factor;
         _target.y +=  mouse_pos_delta.y * factor;
@@ -53,9 +62,9 @@ namespace mv {
       glm::vec2 mouse_scroll_delta = Input::mouse_scroll_delta();
 
       if ( glm::abs( mouse_scroll_delta.y ) > 0.0f ) {
-        float old_z = _target.z;
+        double old_z = _target.z;
 
-        _target.z += glm::mix( 0.0f, _target.z, -mouse_scroll_delta.y ) / _zoom_sensitivity;
+        _target.z += glm::mix( 0.0, _target.z, (double)-mouse_scroll_delta.y ) / _zoom_sensitivity;
 
         /* While zooming in the dist between camera and focus point is */
         /* larger than dist while zooming out, that is why zooming in  */
@@ -68,14 +77,14 @@ namespace mv {
 
         /* zoom to where the mouse is pointing */
         {
-          float delta = old_z - _target.z;
+          double delta = old_z - _target.z;
 
           glm::vec2 mouse_position = Input::mouse_position();
           mouse_position.x -= _width / 2.0f;
           mouse_position.y = ( _height / 2.0f ) - mouse_position.y;
 
-          float x_offset = delta * mouse_position.x;
-          float y_offset = delta * mouse_position.y;
+          double x_offset = delta * mouse_position.x;
+          double y_offset = delta * mouse_position.y;
 
           _target.x += x_offset;
           _target.y += y_offset;
@@ -84,13 +93,13 @@ namespace mv {
       }
 
       if (Input::is_mouse_double_clicked(MOUSE_BUTTON_LEFT)) {
-        glm::vec3 mouse_pos = glm::vec3(get_mouse_world_pos(), 0.0f);
-        _target = glm::vec3(mouse_pos.x, mouse_pos.y, _position.z / 5.0f);
+        glm::dvec2 mouse_pos = get_mouse_world_pos();
+        _target = glm::dvec3(mouse_pos.x, mouse_pos.y, _position.z / 5.0);
       }
 
       /* seek the target */
       {
-        _position = glm::lerp( _position, _target, _deacceleration_panning );
+        _position = glm::lerp( _position, _target, (double)_deacceleration_panning );
       }
 
     }
@@ -101,32 +110,47 @@ namespace mv {
       _height = new_size.y;
     }
 
-    void set_position( glm::vec3 position ) {
+    void set_position( glm::dvec3 position ) {
       /* set the camera's position */
       _position = position;
       _target = position;
     }
 
-    void set_target( glm::vec3 position ) {
+    void set_target( glm::dvec3 position ) {
       /* set the target's position */
       _target = position;
     }
 
-    inline glm::vec3 get_position( void ) const {
+    inline glm::dvec3 get_position( void ) const {
       return _position;
     }
 
-    inline glm::vec2 get_mouse_world_pos( void ) const {
-      /* get mouse position in normalized device coordinates */
-      glm::vec2 mouse_position = Input::mouse_position();
-      mouse_position.x -= _width / 2.0f;
-      mouse_position.y = ( _height / 2.0f ) - mouse_position.y;
+    /* return the part of the world visible in the window */
+    inline Box view_box( void ) const {
+      glm::dvec3 center = glm::dvec3( _position.x, _position.y, 0.0 );
+      glm::dvec3 half_size = glm::dvec3( _width, _height, 0.0 ) * ( _position.z / 2.0 );
+
+      Box box;
+      box.include( center - half_size );
+      box.include( center + half_size );
+      return box;
+    }
+
+    inline glm::dvec2 get_mouse_world_pos( void ) const {
+      return screen_to_world( Input::mouse_position() );
+    }
+
+    /* return the world position under the window position `screen` */
+    inline glm::dvec2 screen_to_world( glm::vec2 screen ) const {
+      /* get the position relative to the center of the window */
+      screen.x -= _width / 2.0f;
+      screen.y = ( _height / 2.0f ) - screen.y;
 
-      /* translate using mouse x and y */
-      glm::vec2 camera_pos_xy = glm::vec2( _position.x, _position.y );
+      /* translate using x and y */
+      glm::dvec2 camera_pos_xy = glm::dvec2( _position.x, _position.y );
 
       /* scale using z coordinate */
-      return camera_pos_xy + ( glm::vec2( mouse_position ) * _position.z );
+      return camera_pos_xy + ( glm::dvec2( screen ) * _position.z );
     }
 
     inline glm::vec2 get_size( void ) const { return { _width, _height }; }
@@ -138,14 +162,14 @@ namespace mv {
     /* width and height of the window */
     float _width = 0.0f, _height = 0.0f;
 
-    /* camera's world position */
-    glm::vec3 _position   = glm::vec3( 0.0f, 0.0f, 1.0f );
+    /* camera's world position, in double like the positions of the geometries */
+    glm::dvec3 _position  = glm::dvec3( 0.0, 0.0, 1.0 );
 
     /* pre-computed projection matrix */
     glm::mat4 _projection = glm::mat4( 1.0f );
 
     /* the camera continuously seek _target `position` */
-    glm::vec3 _target     = _position;
+    glm::dvec3 _target    = _position;
 
     /* deacceleration strength panning */
     float _deacceleration_panning = 0.09f;
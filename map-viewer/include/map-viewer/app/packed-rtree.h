@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include <core/math.h>
+
+namespace mv {
+
+  /* Static R-tree over the boxes of a fixed number of items, e.g. the       */
+  /* geometries of a layer. The items are sorted along a Hilbert curve       */
+  /* through the centers of their boxes and packed `NODE_SIZE` to a node,    */
+  /* the nodes are packed the same way level after level up to the root.     */
+  /* All the boxes are in one array, the leaves first and the root last, so  */
+  /* the children of a node are found from its position and a query walks    */
+  /* over consecutive memory.                                                */
+  /*                                                                         */
+  /* The boxes are two dimensional, the z of the given boxes is ignored.     */
+  class PackedRTree {
+  public:
+    static constexpr uint32_t NODE_SIZE = 16;
+  public:
+    PackedRTree( void );
+    ~PackedRTree( void );
+  public:
+    /* build the tree over `boxes`, the item at `i` has the box `boxes[i]` */
+    void build( const std::vector<Box>& boxes );
+
+    /* Change the box of `item` and grow or shrink its parents to fit. The */
+    /* item keeps its place so the tree gets looser the further it moves.  */
+    void update( uint32_t item, const Box& box );
+
+    /* append the items whose box overlaps `box` to `items` */
+    void query( const Box& box, std::vector<uint32_t>& items ) const;
+
+    /* append the items whose box contains `point` to `items` */
+    void query( const glm::dvec2& point, std::vector<uint32_t>& items ) const;
+
+    /* Append the nodes of `level` whose box overlaps `box` to `nodes` in     */
+    /* order, a node is given by its position in its level. The leaves are    */
+    /* level 0 and a node of `level` covers `NODE_SIZE^level` leaves from     */
+    /* `node * NODE_SIZE^level` on. A level above the root is the root level. */
+    void query_nodes( const Box& box, uint32_t level, std::vector<uint32_t>& nodes ) const;
+
+    /* return the item of the leaf at `leaf`, the leaves follow the curve */
+    inline uint32_t item( uint32_t leaf ) const { return _items[leaf]; }
+
+    /* return the leaf of `item` */
+    inline uint32_t leaf( uint32_t item ) const { return _leaves[item]; }
+
+    /* return the number of levels, the leaves and the levels of nodes up to the root */
+    inline uint32_t levels( void ) const { return _levels.empty() ? 0 : (uint32_t)_levels.size() - 1; }
+
+    /* return the number of items */
+    inline uint32_t size( void ) const { return (uint32_t)_items.size(); }
+
+    /* is the tree empty */
+    inline bool empty( void ) const { return _items.empty(); }
+
+    /* remove all the items */
+    void clear( void );
+  private:
+    /* two dimensional box of a node */
+    struct NodeBox {
+      glm::dvec2 min;
+      glm::dvec2 max;
+
+      inline bool overlaps( const NodeBox& other ) const {
+        return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+      }
+    };
+
+    /* return the distance of `point` along a Hilbert curve over a 2^16 x 2^16 grid */
+    static uint32_t hilbert( uint32_t x, uint32_t y );
+
+    /* recompute the box of the node at `node` of `level` from its children */
+    void fit( uint32_t level, size_t node );
+
+    /* append the nodes of `level` whose box overlaps `box` in order */
+    void search( const NodeBox& box, uint32_t level, std::vector<uint32_t>& nodes ) const;
+  private:
+    /* the boxes of the leaves in the order of the curve, followed by the */
+    /* boxes of the nodes of every level up to the root                   */
+    std::vector<NodeBox> _boxes;
+
+    /* index of the first box of every level, followed by the number of boxes */
+    std::vector<size_t> _levels;
+
+    /* the item of every leaf and the leaf of every item */
+    std::vector<uint32_t> _items;
+    std::vector<uint32_t> _leaves;
+  };
+
+}
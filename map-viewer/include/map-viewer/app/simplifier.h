@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include <app/geometry.h>
+
+namespace mv {
+
+  /* Simplifies the rings of geometries with Douglas-Peucker. A ring is given */
+  /* as the indices of its vertices in the positions of a geometry so that a  */
+  /* simplified ring can be simplified again with a larger tolerance without  */
+  /* copying any position. The ring is closed, the last vertex connects back  */
+  /* to the first.                                                            */
+  /*                                                                          */
+  /* A context must only be used by one thread, `get` returns the context     */
+  /* of the calling thread which lives as long as the thread.                 */
+  class Simplifier {
+  public:
+    Simplifier( void );
+    ~Simplifier( void );
+  public:
+    /* return the context of the calling thread */
+    static Simplifier& get( void );
+
+    /* Return the indices of the vertices of the ring made of the `vertices` */
+    /* indices at `ring` which are kept so that no removed vertex is further */
+    /* than `tolerance` from the simplified ring. The result is empty if the */
+    /* ring collapses to less than three vertices. The indices are only      */
+    /* valid until the next call.                                            */
+    const std::vector<vertex_index>& simplify( const glm::dvec3* positions, const vertex_index* ring, uint32_t vertices, double tolerance );
+  private:
+    /* return the squared distance of `p` from the segment from `a` to `b` */
+    static double distance2( const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b );
+  private:
+    /* spans of the ring left to split, the end of the last span is the first vertex again */
+    std::vector<std::pair<uint32_t, uint32_t>> _stack;
+
+    /* weather the vertex at the same position in the ring is kept */
+    std::vector<uint8_t> _keep;
+
+    /* indices of the kept vertices */
+    std::vector<vertex_index> _kept;
+  };
+
+}
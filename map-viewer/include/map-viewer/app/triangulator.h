@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+
+#include <app/geometry.h>
+#include <app/earcut.h>
+
+namespace mapbox {
+  namespace util {
+
+    /* earcut reads the x and y of the positions of a geometry directly */
+    template <> struct nth<0, glm::dvec3> {
+      inline static double get( const glm::dvec3& position ) { return position.x; }
+    };
+
+    template <> struct nth<1, glm::dvec3> {
+      inline static double get( const glm::dvec3& position ) { return position.y; }
+    };
+
+  }
+}
+
+namespace mv {
+
+  /* number of rings triangulated by each path */
+  struct TriangulationStats {
+    size_t fan_rings    = 0;
+    size_t earcut_rings = 0;
+
+    inline TriangulationStats& operator+=( const TriangulationStats& other ) {
+      fan_rings += other.fan_rings;
+      earcut_rings += other.earcut_rings;
+      return *this;
+    }
+  };
+
+  /* Triangulates the polygons of geometries. A convex polygon without      */
+  /* holes is split in a fan from its first vertex, everything else goes    */
+  /* through earcut. The nodes, the indices and the hole queue of earcut    */
+  /* are kept between the polygons, so a context stops allocating once it   */
+  /* has seen the largest polygon. The rings are read in place from the     */
+  /* geometry through views.                                                */
+  /*                                                                        */
+  /* A context must only be used by one thread, `get` returns the context   */
+  /* of the calling thread which lives as long as the thread.               */
+  class Triangulator {
+  public:
+    Triangulator( void );
+    ~Triangulator( void );
+  public:
+    /* return the context of the calling thread */
+    static Triangulator& get( void );
+
+    /* Triangulate `polygon` and return the indices of the triangles, they */
+    /* are combined indices in the geometry. The indices are only valid    */
+    /* until the next call.                                                */
+    const std::vector<vertex_index>& triangulate( const Polygon& polygon );
+
+    /* Triangulate a polygon made of some of the vertices of `geometry`, */
+    /* e.g. a simplified polygon. `vertices` has the combined indices    */
+    /* of the vertices of every ring one ring after the other,           */
+    /* `ring_sizes` the number of them in every ring and the first ring  */
+    /* is the outer ring. The indices of the triangles are combined      */
+    /* indices in the geometry, they are only valid until the next call. */
+    const std::vector<vertex_index>& triangulate( const Geometry& geometry, const std::vector<vertex_index>& vertices, const std::vector<uint32_t>& ring_sizes );
+
+    /* rings triangulated by this context so far */
+    inline const TriangulationStats& stats( void ) const { return _stats; }
+  private:
+    /* A ring as earcut wants it, either consecutive positions or the */
+    /* positions at some indices when `indices` is not null.          */
+    struct RingView {
+      using value_type = glm::dvec3;
+
+      const glm::dvec3*   positions;
+      const vertex_index* indices;
+      uint32_t            vertices;
+
+      inline size_t size( void ) const { return vertices; }
+      inline const glm::dvec3& operator[]( size_t index ) const { return positions[indices ? indices[index] : index]; }
+    };
+
+    /* a polygon as earcut wants a list of rings */
+    struct PolygonView {
+      const std::vector<RingView>& rings;
+
+      inline size_t size( void ) const { return rings.size(); }
+      inline bool empty( void ) const { return rings.empty(); }
+      inline const RingView& operator[]( size_t index ) const { return rings[index]; }
+    };
+  private:
+    /* triangulate the rings in `_rings`, the indices count the vertices of the rings one after the other */
+    std::vector<vertex_index>& triangulate_rings( void );
+
+    /* Is the ring strictly convex and simple, collinear or repeated */
+    /* vertices are left to earcut which removes them.               */
+    static bool is_convex( const RingView& ring );
+  private:
+    mapbox::detail::Earcut<vertex_index> _earcut;
+
+    /* views of the rings of the polygon being triangulated */
+    std::vector<RingView> _rings;
+
+    /* indices of the fan path */
+    std::vector<vertex_index> _indices;
+
+    TriangulationStats _stats;
+  };
+
+}
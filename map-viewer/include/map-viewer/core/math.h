@@ -13,28 +13,32 @@
 
 namespace mv {
 
+  /* bounding box in double precision, same as the positions of the geometries */
   struct Box {
     /* adjust the bounding box to include to `vertex` */
-    void include( glm::vec3 vertex ) {
+    void include( glm::dvec3 vertex ) {
       min = glm::min( vertex, min );
       max = glm::max( vertex, max );
     }
 
+    /* adjust the bounding box to include the `count` positions at `positions` */
+    void include( const glm::dvec3* positions, size_t count );
+
     void unify( const Box& other ) {
       min = glm::min( other.min, min );
       max = glm::max( other.max, max );
     }
 
-    glm::vec3 center( void ) const {
-      return ( max + min ) / 2.0f;
+    glm::dvec3 center( void ) const {
+      return ( max + min ) / 2.0;
     }
 
-    glm::vec3 size( void ) const {
+    glm::dvec3 size( void ) const {
       return glm::abs( max - min );
     }
 
-    glm::vec3 min = glm::vec3(  std::numeric_limits<float>::max() );
-    glm::vec3 max = glm::vec3( -std::numeric_limits<float>::max() );
+    glm::dvec3 min = glm::dvec3(  std::numeric_limits<double>::max() );
+    glm::dvec3 max = glm::dvec3( -std::numeric_limits<double>::max() );
   };
 
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <utils/singleton.h>
+#include <types.h>
+
+namespace mv {
+
+  /* Progress of a long task running on another thread, the task updates  */
+  /* `done` out of `total` and stops as soon as it sees `cancelled` set.   */
+  struct TaskProgress {
+    std::atomic<size_t> done      = 0;
+    std::atomic<size_t> total     = 0;
+    std::atomic<bool>   cancelled = false;
+
+    /* completed fraction in [0, 1] */
+    inline float fraction( void ) const {
+      size_t all = total;
+      return all > 0 ? (float)std::min<size_t>( done, all ) / (float)all : 0.0f;
+    }
+  };
+
+  /* Fixed number of worker threads which run the tasks pushed to */
+  /* the queue. Created once by the core and shared by everyone   */
+  /* who wants to do heavy work on more than one core.            */
+  class ThreadPool final : public Singleton<ThreadPool> {
+    REGISTER_SINGLETON_CLASS( ThreadPool );
+  protected:
+    /* zero threads means one thread for every hardware thread */
+    ThreadPool( uint32_t num_threads = 0 );
+    ~ThreadPool( void );
+  public:
+    /* push a task in the queue, it is run by one of the workers */
+    void submit( std::function<void( void )> task );
+
+    /* Call `func` for every index in [0, count) and return when all the  */
+    /* calls are done. The calling thread also takes indices instead of   */
+    /* waiting so this can be called from inside a task as well. The      */
+    /* first exception thrown by `func` is rethrown on the calling thread.*/
+    void parallel_for( size_t count, const std::function<void( size_t )>& func );
+
+    inline uint32_t num_threads( void ) const { return (uint32_t)_workers.size(); }
+  private:
+    void worker_loop( void );
+  private:
+    std::vector<std::thread> _workers;
+
+    std::queue<std::function<void( void )>> _tasks;
+    std::mutex                              _mutex;
+    std::condition_variable                 _condition;
+    bool                                    _stop = false;
+  };
+
+}
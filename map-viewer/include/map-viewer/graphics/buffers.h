@@ -3,6 +3,7 @@
 #include <tuple>
 #include <typeinfo>
 #include <vector>
+#include <cstring>
 
 #include <types.h>
 #include <utils/ref.h>
@@ -68,8 +69,57 @@ namespace mv {
   void* map_vertex_buffer( uint32_t buffer_id, size_t size );
   void unmap_vertex_buffer( uint32_t buffer_id );
   void update_vertex_buffer_element( uint32_t buffer_id, size_t offset, size_t size, const void* data );
-  uint32_t insert_in_vertex_buffer( uint32_t buffer_id, size_t offset, size_t size, const void* data );
-  uint32_t replace_vertex_buffer_memory( uint32_t buffer_id, size_t offset, size_t old_size, size_t new_size, const void* data );
+
+  /* Create a buffer which stays mapped for writing until it is deleted, */
+  /* the mapping is coherent so the writes reach the GPU without a flush */
+  /* or an unmap. The mapped memory is returned in `mapped`.             */
+  uint32_t create_persistent_buffer( size_t size_in_bytes, const void* data, void** mapped );
+
+  /* Fence after the commands sent so far. `wait_fence` blocks until the */
+  /* GPU is done with them and deletes the fence, a null fence is done.  */
+  void* create_fence( void );
+  void wait_fence( void* fence );
+  void delete_fence( void* fence );
+
+  /* Insert or replace memory in a buffer holding `size` bytes in `capacity` */
+  /* bytes. The data after the range is shifted within the buffer while it   */
+  /* fits, otherwise the buffer is reallocated with room to grow and the new */
+  /* id is returned and `capacity` updated.                                  */
+  uint32_t insert_in_vertex_buffer( uint32_t buffer_id, size_t& capacity, size_t size, size_t offset, size_t insert_size, const void* data );
+  uint32_t replace_vertex_buffer_memory( uint32_t buffer_id, size_t& capacity, size_t size, size_t offset, size_t old_size, size_t new_size, const void* data );
+
+  /* range of bytes copied from one buffer to another */
+  struct BufferCopy {
+    size_t from;
+    size_t to;
+    size_t size;
+  };
+
+  /* Create a buffer of `size` bytes with the ranges of `buffer_id` given */
+  /* by `copies` and delete the old one. Returns the id of the new buffer */
+  /* and sets `capacity` to its size.                                     */
+  uint32_t gather_vertex_buffer( uint32_t buffer_id, size_t& capacity, size_t size, const std::vector<BufferCopy>& copies );
+
+  /* what the edits of the vertex and index buffers cost since the start */
+  struct BufferStats {
+    uint32_t reallocations = 0;
+    uint32_t shifts        = 0;
+    size_t   bytes_copied  = 0;
+  };
+
+  /* return the stats of the buffer edits */
+  const BufferStats& buffer_stats( void );
+
+  /* how the memory of a vertex buffer is written */
+  enum class BufferUsage {
+    /* written with `set_range` and the other calls or between `map` and `unmap` */
+    Dynamic,
+
+    /* Mapped once for the life of the buffer and written straight through */
+    /* `mapped_buffer`. The size is fixed, the writer must not touch what  */
+    /* the GPU may still be reading.                                       */
+    Persistent
+  };
 
   /* Vertex buffer with variable number of arguments for */
   /* the vertex attributes. By using this we don't have  */
@@ -77,7 +127,7 @@ namespace mv {
   template<typename... Args>
   class VertexBuffer : public SharedObject {
   public:
-    VertexBuffer( size_t array_size, const void* data );
+    VertexBuffer( size_t array_size, const void* data, BufferUsage usage = BufferUsage::Dynamic );
     ~VertexBuffer( void );
   public:
     /* Bind the vertex buffer to the pipeline, you won't need  */
@@ -90,6 +140,10 @@ namespace mv {
     /* `unmap` call.                                          */
     void set( size_t index, std::tuple<Args...> data );
 
+    /* Overwrite `count` elements starting at `offset` with `data`, */
+    /* the buffer size does not change.                             */
+    void set_range( size_t offset, size_t count, const void* data );
+
     /* insert data at offset */
     void insert( size_t offset, std::tuple<Args...> data );
 
@@ -110,6 +164,9 @@ namespace mv {
     /* return the number of vertices in the buffer */
     inline size_t array_size( void ) const { return _buffer_array_size; }
 
+    /* return the number of vertices that fit in the buffer before it is reallocated */
+    inline size_t capacity( void ) const { return _capacity / _vertex_size; }
+
     /* return the OpenGL buffer id */
     inline uint32_t buffer_id( void ) const { return _buffer_id; }
 
@@ -119,7 +176,7 @@ namespace mv {
     /* return the vertex size of the buffer */
     inline size_t vertex_size( void ) const { return _vertex_size; }
 
-    /* return the mapped buffer */
+    /* return the mapped buffer, always mapped if the buffer is persistent */
     inline uint8_t* mapped_buffer( void ) const { return _mapped_buffer; }
   private:
     /* The function simply iterate over all the elements in  */
@@ -150,12 +207,19 @@ namespace mv {
     /* have 3 float in Position3 and 4 in Color4.            */
     size_t _vertex_size = 0;
 
+    /* size of the GPU memory of the buffer in bytes, the vertices after */
+    /* `_buffer_array_size` are room to grow                             */
+    size_t _capacity = 0;
+
     /* Mapped buffer, this must only be used after a valid   */
     /* `map` call. Before drawing `unmap` must be called.    */
     uint8_t* _mapped_buffer = nullptr;
 
     /* To determine weather the buffer is mapped or not.     */
     bool _is_mapped = false;
+
+    /* how the memory of the buffer is written */
+    BufferUsage _usage = BufferUsage::Dynamic;
   };
 
   template<typename... Args>
@@ -182,8 +246,8 @@ namespace mv {
   }
 
   template<typename... Args>
-  inline VertexBuffer<Args...>::VertexBuffer( size_t array_size, const void* data ) :
-    _buffer_array_size( array_size ) {
+  inline VertexBuffer<Args...>::VertexBuffer( size_t array_size, const void* data, BufferUsage usage ) :
+    _buffer_array_size( array_size ), _usage( usage ) {
     PROFILE_FUNCTION();
 
     /* compute the vertex size */
@@ -192,9 +256,13 @@ namespace mv {
 
     /* compute the total size in byes for the buffer */
     size_t size_in_bytes = _buffer_array_size * vertex_size;
+    _capacity = size_in_bytes;
 
-    /* create the buffer in GPU memory */
-    _buffer_id = create_vertex_buffer( size_in_bytes, data );
+    /* create the buffer in GPU memory, a persistent one is mapped from now on */
+    if ( _usage == BufferUsage::Persistent )
+      _buffer_id = create_persistent_buffer( size_in_bytes, data, (void**)&_mapped_buffer );
+    else
+      _buffer_id = create_vertex_buffer( size_in_bytes, data );
   }
   
   template<typename... Args>
@@ -231,10 +299,25 @@ namespace mv {
     update_vertex_buffer_element( _buffer_id, index * _vertex_size, _vertex_size, byte_buffer.data() );
   }
 
+  template<typename... Args>
+  inline void VertexBuffer<Args...>::set_range( size_t offset, size_t count, const void* data ) {
+    PROFILE_FUNCTION();
+
+    if ( offset + count > _buffer_array_size ) {
+      LOG_ERROR( "range out of bounds, cannot update vertex buffer data: array_size = {}, requested_range = [{}, {})", _buffer_array_size, offset, offset + count );
+      return;
+    }
+
+    if ( count > 0 )
+      update_vertex_buffer_element( _buffer_id, offset * _vertex_size, count * _vertex_size, data );
+  }
+
   template<typename... Args>
   inline void VertexBuffer<Args...>::insert( size_t offset, std::tuple<Args...> data ) {
     PROFILE_FUNCTION();
 
+    MV_ASSERT( _usage == BufferUsage::Dynamic );
+
     if ( offset > _buffer_array_size ) {
       LOG_ERROR( "index out of bounds, cannot insert vertex buffer data: array_size = {}, requested_index = {}", _buffer_array_size, offset );
       return;
@@ -246,7 +329,7 @@ namespace mv {
       ( memcpy( byte_buffer.data() + get_offset( args ), args.data, get_size_in_bytes( args.attribute_type() ) ), ... );
     }, data );
 
-    _buffer_id = insert_in_vertex_buffer( _buffer_id, offset * _vertex_size, _vertex_size, byte_buffer.data() );
+    _buffer_id = insert_in_vertex_buffer( _buffer_id, _capacity, _buffer_array_size * _vertex_size, offset * _vertex_size, _vertex_size, byte_buffer.data() );
     _buffer_array_size++;
   }
 
@@ -254,9 +337,10 @@ namespace mv {
   inline void VertexBuffer<Args...>::replace( size_t offset, size_t elements_to_remove, size_t num_elements, void* data ) {
     PROFILE_FUNCTION();
 
-    MV_ASSERT( data );
+    MV_ASSERT( data && _usage == BufferUsage::Dynamic );
 
-    _buffer_id = replace_vertex_buffer_memory( _buffer_id, offset * _vertex_size, elements_to_remove * _vertex_size, num_elements * _vertex_size, data );
+    _buffer_id = replace_vertex_buffer_memory( _buffer_id, _capacity, _buffer_array_size * _vertex_size, offset * _vertex_size, elements_to_remove * _vertex_size,
+                                               num_elements * _vertex_size, data );
     _buffer_array_size += ( num_elements - elements_to_remove );
   }
 
@@ -264,6 +348,10 @@ namespace mv {
   inline void VertexBuffer<Args...>::map( void ) {
     PROFILE_FUNCTION();
 
+    /* a persistent buffer is always mapped */
+    if ( _usage == BufferUsage::Persistent )
+      return;
+
     _mapped_buffer = (uint8_t*)map_vertex_buffer( _buffer_id, _buffer_array_size * _vertex_size );
     MV_ASSERT( _mapped_buffer );
     _is_mapped = true;
@@ -355,24 +443,115 @@ namespace mv {
     return _cpu_view[index];
   }
 
+  /* OpenGL function to handle a uniform buffer. They are */
+  /* automatically called from the respective classes so  */
+  /* no need to call them by yourself.                    */
+  uint32_t create_uniform_buffer( size_t size_in_bytes, const void* data );
+  void delete_uniform_buffer( uint32_t buffer_id );
+  void update_uniform_buffer( uint32_t buffer_id, size_t size_in_bytes, const void* data );
+  void bind_uniform_buffer( uint32_t binding, uint32_t buffer_id );
+
+  /* Block of uniforms shared by the draws that bind it, `T` must have */
+  /* the std140 layout of the block in the shader with the padding     */
+  /* written out. The GPU memory is only written when the data change. */
+  template<typename T>
+  class UniformBuffer : public SharedObject {
+  public:
+    UniformBuffer( const T& data = T() );
+    ~UniformBuffer( void );
+  public:
+    /* upload `data` unless it is what the buffer already holds */
+    void set( const T& data );
+
+    /* bind the buffer to the block with `layout( binding = binding )` */
+    void bind( uint32_t binding ) const;
+
+    /* return the data in the buffer */
+    inline const T& data( void ) const { return _data; }
+
+    /* return the OpenGL buffer id */
+    inline uint32_t buffer_id( void ) const { return _buffer_id; }
+  private:
+    /* copy of the GPU memory to compare the new data with */
+    T _data;
+
+    /* OpenGL buffer id */
+    uint32_t _buffer_id = 0;
+  };
+
+  template<typename T>
+  inline UniformBuffer<T>::UniformBuffer( const T& data ) : _data( data ) {
+    PROFILE_FUNCTION();
+
+    _buffer_id = create_uniform_buffer( sizeof( T ), &_data );
+  }
+
+  template<typename T>
+  inline UniformBuffer<T>::~UniformBuffer( void ) {
+    PROFILE_FUNCTION();
+
+    delete_uniform_buffer( _buffer_id );
+  }
+
+  template<typename T>
+  inline void UniformBuffer<T>::set( const T& data ) {
+    PROFILE_FUNCTION();
+
+    if ( memcmp( &_data, &data, sizeof( T ) ) == 0 )
+      return;
+
+    _data = data;
+    update_uniform_buffer( _buffer_id, sizeof( T ), &_data );
+  }
+
+  template<typename T>
+  inline void UniformBuffer<T>::bind( uint32_t binding ) const {
+    bind_uniform_buffer( binding, _buffer_id );
+  }
+
 
   /* Index buffer is used to do random access on vertex data while  */
   /* drawing, the major benifit here is that we can reuse vertices. */
   /* This reduce memory usage and also make editing data simpler.   */
   class IndexBuffer : public SharedObject {
+  public:
+    /* Index that ends a strip and starts a new one in the same draw, */
+    /* primitive restart is always enabled by the render state.       */
+    static constexpr uint32_t RESTART = 0xFFFFFFFF;
   public:
     IndexBuffer( const std::vector<uint32_t> indices );
+
+    /* create a buffer with `count` indices, `data` may be null to fill it later */
+    IndexBuffer( size_t count, const uint32_t* data );
     ~IndexBuffer( void );
   public:
     /* bind the index buffer to the pipeline */
     void bind( void ) const;
 
+    /* Overwrite `count` indices starting at `offset` with `data`, */
+    /* the buffer size does not change.                            */
+    void set_range( size_t offset, size_t count, const uint32_t* data );
+
+    /* Replace indices with new memory, this also increase */
+    /* buffer size if the new size is more than the old.   */
+    void replace( size_t offset, size_t indices_to_remove, size_t num_indices, const uint32_t* data );
+
+    /* Move the indices into a new buffer of `num_indices` indices, `copies` */
+    /* gives the ranges to keep and where they go in indices.                */
+    void gather( size_t num_indices, const std::vector<BufferCopy>& copies );
+
     /* return the number of indices in the buffer */
     inline uint32_t indices( void ) const { return _num_indices; }
+
+    /* return the OpenGL buffer id */
+    inline uint32_t buffer_id( void ) const { return _buffer_id; }
   private:
     /* number of indices in the buffer */
     size_t _num_indices = 0;
 
+    /* size of the GPU memory of the buffer in bytes */
+    size_t _capacity = 0;
+
     /* OpenGL buffer id */
     uint32_t _buffer_id = 0;
   };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stack>
+#include <vector>
 #include <unordered_map>
 
 #include <core/math.h>
@@ -35,11 +36,30 @@ namespace mv {
     float    min_depth, max_depth;
   };
 
+  /* ranges of the bound index buffer drawn with one call, in indices */
+  struct DrawRanges {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> counts;
+
+    inline void add( uint32_t offset, uint32_t count ) {
+      offsets.push_back( offset );
+      counts.push_back( count );
+    }
+
+    inline void clear( void ) {
+      offsets.clear();
+      counts.clear();
+    }
+  };
+
   struct Stats {
     uint32_t num_triangles = 0;
     uint32_t num_lines     = 0;
     uint32_t num_points    = 0;
     uint32_t draw_calls    = 0;
+
+    /* input layouts created, the shaders keep them for the next frames */
+    uint32_t input_layouts = 0;
   };
 
   class RenderState : public Singleton<RenderState> {
@@ -72,16 +92,33 @@ namespace mv {
     /* draw call */
     void draw( uint32_t num_vertices, uint32_t offset = 0 );
     void draw_index( uint32_t index_count, uint32_t offset = 0 );
+    void draw_index( const DrawRanges& ranges );
+
+    /* count an input layout created by a shader */
+    inline void count_input_layout( void ) { _stats.input_layouts++; }
+
+    /* Buffer of at least `size` bytes to copy data through when it moves */
+    /* within one buffer. It grows as needed and lives as long as the     */
+    /* render state, which deletes it before the context goes away.       */
+    uint32_t scratch_buffer( size_t size );
 
     /* return stats */
     inline Stats stats( void ) const { return _stats; }
   private:
     /* internal helper functions */
     void set_viewport( Viewport viewport );
+    void count_primitives( uint32_t num_vertices );
   private:
     std::stack<Topology> _topologies;
     std::stack<Viewport> _viewports;
 
+    /* byte offsets of the ranges of the last multi draw */
+    std::vector<const void*> _draw_offsets;
+
+    /* buffer returned by `scratch_buffer` and its size in bytes */
+    uint32_t _scratch_buffer   = 0;
+    size_t   _scratch_capacity = 0;
+
     Stats _stats;
   };
 
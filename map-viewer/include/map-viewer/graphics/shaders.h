@@ -1,8 +1,9 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <algorithm>
 #include <typeinfo>
-#include <any>
 #include <unordered_map>
 
 #include <types.h>
@@ -17,6 +18,12 @@ namespace mv {
   /*         thing. OpenGL use `vertex array` whereas directx */
   /*         use `input layout` for shader input.             */
 
+  /* Uniform given a fixed location with `layout( location = N )` in */
+  /* the shader, it is set without looking up its name.              */
+  struct UniformLocation {
+    int32_t location;
+  };
+
   /* Represents a shader object which contains a combination of  */
   /* vertex and fragment shaders. The shader program can be used */
   /* to specify vertex transformation and fragment colors in the */
@@ -30,6 +37,35 @@ namespace mv {
       uint32_t       offset;
       size_t         stride;
     };
+
+    /* ids of the vertex buffers of an input layout, 0 after the last */
+    using VertexKey = std::array<uint32_t, 4>;
+
+    /* The input layouts are kept by the ids of their vertex and */
+    /* index buffers, the ids are never 0 for a buffer so the    */
+    /* unused entries and the missing index buffer are 0.        */
+    struct InputKey {
+      VertexKey vertex_buffers = {};
+      uint32_t  index_buffer   = 0;
+
+      bool uses( uint32_t buffer_id ) const {
+        return index_buffer == buffer_id || std::find( vertex_buffers.begin(), vertex_buffers.end(), buffer_id ) != vertex_buffers.end();
+      }
+
+      bool operator ==( const InputKey& other ) const {
+        return vertex_buffers == other.vertex_buffers && index_buffer == other.index_buffer;
+      }
+    };
+
+    struct InputLayout {
+      InputKey key;
+      uint32_t vertex_attribute;
+    };
+
+    struct InputLayoutDescs {
+      VertexKey                    vertex_buffers;
+      std::vector<InputLayoutDesc> descs;
+    };
   public:
     Shader( const string& vertex_shader_code, const string& fragment_shader_code );
     ~Shader( void );
@@ -43,12 +79,21 @@ namespace mv {
     /* Since input layout is dependent on the shader it makes    */
     /* much more sense to insert input data to the shader rather */
     /* than creating input layout separately and binding it to   */
-    /* the pipeline. Currently whenever this function is called  */
-    /* a new input layout is created, but, that can easily be    */
-    /* improved by using a hash table to store the input layout. */
+    /* the pipeline. The input layouts are kept by the ids of    */
+    /* their buffers, one is created the first time a set of     */
+    /* buffers is used and only bound by `use` afterwards.       */
     template<typename... Args>
     void set_input_buffers( Args... buffers );
 
+    /* Use `indices` for the indexed draws of the input buffers,  */
+    /* must be called after `set_input_buffers`.                  */
+    void set_index_buffer( Ref<IndexBuffer> indices );
+
+    /* Delete the input layouts of every shader using the buffer, */
+    /* called before the buffer is deleted so that a buffer later */
+    /* given the same id does not get a stale input layout.       */
+    static void release_input_layouts( uint32_t buffer_id );
+
     /* below are the functions to set uniform */
     void set_mat4( const string& uniform_name, const glm::mat4& matrix ) const;
     void set_vec2( const string& uniform_name, const glm::vec2& vector ) const;
@@ -58,10 +103,25 @@ namespace mv {
     void set_ivec3( const string& uniform_name, const glm::ivec3& vector ) const;
     void set_ivec4( const string& uniform_name, const glm::ivec4& vector ) const;
     void set_uint( const string& uniform_name, const uint32_t& value ) const;
+    void set_float( const string& uniform_name, const float& value ) const;
     void set_int( const string& uniform_name, const int32_t& value ) const;
     void set_int_array( const string& uniform_name, size_t size, const int32_t* value ) const;
     void set_uint_array( const string& uniform_name, size_t size, const uint32_t* value ) const;
 
+    /* the same functions for the uniforms with a fixed location */
+    void set_mat4( UniformLocation uniform, const glm::mat4& matrix ) const;
+    void set_vec2( UniformLocation uniform, const glm::vec2& vector ) const;
+    void set_vec3( UniformLocation uniform, const glm::vec3& vector ) const;
+    void set_vec4( UniformLocation uniform, const glm::vec4& vector ) const;
+    void set_ivec2( UniformLocation uniform, const glm::ivec2& vector ) const;
+    void set_ivec3( UniformLocation uniform, const glm::ivec3& vector ) const;
+    void set_ivec4( UniformLocation uniform, const glm::ivec4& vector ) const;
+    void set_uint( UniformLocation uniform, const uint32_t& value ) const;
+    void set_float( UniformLocation uniform, const float& value ) const;
+    void set_int( UniformLocation uniform, const int32_t& value ) const;
+    void set_int_array( UniformLocation uniform, size_t size, const int32_t* value ) const;
+    void set_uint_array( UniformLocation uniform, size_t size, const uint32_t* value ) const;
+
     /* bind the shader storage buffer to the block with `storage_name` */
     template<typename T, size_t S>
     void set_ssbo( const string& storage_name, Ref<ShaderStorageBuffer<T, S>> ssbo ) const;
@@ -69,11 +129,14 @@ namespace mv {
     template<typename T>
     void build_input_layout_desc( std::vector<Shader::InputLayoutDesc>& ild, T& buffer );
 
-    /* create input layout aka vertex attribute for shader input */
-    void create_input_layout( const std::vector<Shader::InputLayoutDesc>& ild );
+    /* create input layout aka vertex attribute for shader input, `index_buffer_id` may be 0 */
+    uint32_t create_input_layout( const std::vector<Shader::InputLayoutDesc>& ild, uint32_t index_buffer_id );
 
-    /* delete the previously created input layout */
-    void delete_input_layout( void );
+    /* delete the input layouts using the buffer */
+    void delete_input_layouts( uint32_t buffer_id );
+
+    /* find or create the input layout of the buffers set last */
+    void select_input_layout( void );
 
     /* bind the input layout to the pipeline */
     void bind_input_layout( void ) const;
@@ -93,13 +156,25 @@ namespace mv {
     /* and simply put it here.                                  */
     uint32_t _shader_program_id = 0;
 
-    /* vertex attribute that define the input layout  */
+    /* vertex attribute that define the input layout, 0 until  */
+    /* `use` selects the one of the buffers set last           */
     uint32_t _vertex_attribute  = 0;
 
-    /* Vertex buffers that currently in use of the shader, this */
-    /* is just here to ensure that the buffers are not released */
-    /* while still in use of the shader.                        */
-    std::vector<std::any> _set_buffers;
+    /* ids of the vertex and index buffers set last */
+    InputKey _input_key;
+
+    /* Attributes of every set of vertex buffers and the input */
+    /* layout of every set of vertex and index buffers, a few  */
+    /* sets are used by a shader so they are searched in turn, */
+    /* only when the buffers set differ from the last ones.    */
+    std::vector<InputLayoutDescs> _input_layout_descs;
+    std::vector<InputLayout>      _input_layouts;
+
+    /* Buffers that currently in use of the shader, this is just */
+    /* here to ensure that the buffers are not released while    */
+    /* still in use of the shader.                               */
+    std::array<Ref<SharedObject>, std::tuple_size_v<VertexKey>> _set_buffers;
+    Ref<IndexBuffer>                                            _set_indices;
 
     /* Shader Storage Buffer binding, this is to speed up the   */
     /* binding process on subsiquient calls to bind the buffer. */
@@ -124,18 +199,45 @@ namespace mv {
   void Shader::set_input_buffers( Args... buffers ) {
     PROFILE_FUNCTION();
 
-    /* generate the input layout desc array to be passed to internal API */
-    std::vector<Shader::InputLayoutDesc> input_layout_desc;
-    ( build_input_layout_desc( input_layout_desc, *buffers ), ... );
-
-    /* remove previous buffer references if any */
-    _set_buffers.clear();
+    static_assert( sizeof...( Args ) <= std::tuple_size_v<VertexKey>, "too many input buffers for a shader" );
+
+    /* the input layouts are found by the ids of the buffers */
+    VertexKey key = {};
+    size_t i = 0;
+    ( ( key[i++] = buffers->buffer_id() ), ... );
+
+    /* the same buffers as the last call are still held and their */
+    /* input layout is still selected unless an index buffer was  */
+    /* set, which is dropped like `set_input_buffers` always does */
+    if ( key == _input_key.vertex_buffers ) {
+      if ( _input_key.index_buffer != 0 ) {
+        _input_key.index_buffer = 0;
+        _set_indices = nullptr;
+        _vertex_attribute = 0;
+      }
+      return;
+    }
+
+    _input_key = { key, 0 };
+    _set_indices = nullptr;
+    _vertex_attribute = 0;
+
+    /* generate the input layout desc array the first time the buffers are used */
+    auto desc = std::find_if( _input_layout_descs.begin(), _input_layout_descs.end(), [&]( const InputLayoutDescs& d ) {
+      return d.vertex_buffers == key;
+    } );
+
+    if ( desc == _input_layout_descs.end() ) {
+      InputLayoutDescs& input_layout_desc = _input_layout_descs.emplace_back( InputLayoutDescs{ key, {} } );
+      ( build_input_layout_desc( input_layout_desc.descs, *buffers ), ... );
+    }
 
     /* hold references to buffer so they do not get deallocated */
-    ( _set_buffers.push_back( buffers ), ... );
+    for ( Ref<SharedObject>& buffer : _set_buffers )
+      buffer = nullptr;
 
-    /* create the internal input layout desc */
-    create_input_layout( input_layout_desc );
+    i = 0;
+    ( ( _set_buffers[i++] = buffers ), ... );
   }
 
   template<typename T, size_t S>
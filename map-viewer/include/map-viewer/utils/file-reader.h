@@ -4,24 +4,60 @@
 #include <sstream>
 #include <codecvt>
 #include <ios>
+#include <string_view>
 
 #include <types.h>
 
 namespace mv {
 
   class DataFile {
+  public:
+    /* `Stream` reads the entire file in memory, `Mapped` maps */
+    /* the file in the address space and the bytes are paged   */
+    /* in by the OS as they are accessed, nothing is copied.   */
+    enum class Mode {
+      Stream,
+      Mapped
+    };
   public:
     DataFile( void );
-    DataFile( const string& filename );
-    ~DataFile( void ) = default;
+    DataFile( const string& filename, Mode mode = Mode::Stream );
+    ~DataFile( void );
+
+    /* the mapping cannot be shared */
+    DataFile( const DataFile& ) = delete;
+    DataFile& operator=( const DataFile& ) = delete;
   public:
-    void open( const string& filename );
+    void open( const string& filename, Mode mode = Mode::Stream );
+    void close( void );
     string content( void );
 
-    operator bool( void ) const { return _wif.operator bool(); }
+    /* Zero-copy view of the file, only valid for the `Mapped` mode and */
+    /* as long as the file is open. The view can be directly used with  */
+    /* rapidjson's `MemoryStream`.                                      */
+    inline std::string_view view( void ) const { return std::string_view( _mapped_data, _mapped_size ); }
+
+    /* size of the mapped file in bytes */
+    inline size_t size( void ) const { return _mapped_size; }
+
+    operator bool( void ) const { return _mode == Mode::Mapped ? _is_mapped : _wif.operator bool(); }
   private:
+    Mode _mode = Mode::Stream;
+
     std::stringstream _wss;
     std::ifstream     _wif;
+
+    /* memory mapped file */
+    const char* _mapped_data = nullptr;
+    size_t      _mapped_size = 0;
+    bool        _is_mapped   = false;
+
+  #ifdef _WIN32
+    void* _file_handle    = nullptr;
+    void* _mapping_handle = nullptr;
+  #else
+    int   _file_descriptor = -1;
+  #endif
   };
 
 }
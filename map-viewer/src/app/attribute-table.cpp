@@ -0,0 +1,387 @@
+#include <app/attribute-table.h>
+
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+
+namespace mv {
+
+  AttributeTable::AttributeTable( void ) {} /* do nothing */
+  AttributeTable::~AttributeTable( void ) {} /* do nothing */
+
+  uint32_t AttributeTable::column( const string& name ) {
+    uint32_t index = find_column( name );
+    if ( index != INVALID_COLUMN )
+      return index;
+
+    index = (uint32_t)_columns.size();
+
+    /* the column is null in all the rows before it was seen */
+    Column& column = _columns.emplace_back();
+    column.name = name;
+    column.types.resize( _rows, AttributeType::Null );
+    column.values.resize( _rows, 0 );
+
+    _column_index.emplace( column.name, index );
+    return index;
+  }
+
+  uint32_t AttributeTable::find_column( const string& name ) const {
+    auto it = _column_index.find( name );
+    return it != _column_index.end() ? it->second : INVALID_COLUMN;
+  }
+
+  void AttributeTable::add_row( void ) {
+    for ( Column& column : _columns ) {
+      /* decided between rows so that the strings of a row stay at the end of the pool */
+      check_encoding( column );
+
+      column.types.push_back( AttributeType::Null );
+      column.values.push_back( 0 );
+    }
+
+    mark_last_row();
+    _rows++;
+  }
+
+  void AttributeTable::pop_row( void ) {
+    if ( _rows == 0 )
+      return;
+
+    /* the columns first seen in the row go away with it */
+    while ( _columns.size() > _last_row_columns ) {
+      _column_index.erase( _columns.back().name );
+      _columns.pop_back();
+    }
+
+    for ( Column& column : _columns ) {
+      column.types.pop_back();
+      column.values.pop_back();
+
+      /* the encoding is only changed between rows, so the strings */
+      /* added for the row are at the end of the dictionary        */
+      for ( size_t code = column.last_row_dictionary; code < column.dictionary.size(); code++ )
+        column.dictionary_index.erase( column.dictionary[code] );
+
+      column.dictionary.resize( column.last_row_dictionary );
+      column.string_cells = column.last_row_string_cells;
+      column.set_rows = 0;
+    }
+
+    _string_ends.resize( _last_row_strings );
+    _string_chars.resize( _string_ends.empty() ? 0 : _string_ends.back() );
+    _rows--;
+  }
+
+  void AttributeTable::mark_last_row( void ) {
+    for ( Column& column : _columns ) {
+      column.last_row_dictionary = column.dictionary.size();
+      column.last_row_string_cells = column.string_cells;
+    }
+
+    _last_row_strings = _string_ends.size();
+    _last_row_columns = (uint32_t)_columns.size();
+  }
+
+  bool AttributeTable::set( uint32_t column, AttributeType type, uint64_t value ) {
+    Column& entry = _columns[column];
+    if ( entry.set_rows == _rows )
+      return false;
+
+    entry.types[_rows - 1] = type;
+    entry.values[_rows - 1] = value;
+    entry.set_rows = _rows;
+    return true;
+  }
+
+  void AttributeTable::set_null( uint32_t column ) {
+    set( column, AttributeType::Null, 0 );
+  }
+
+  void AttributeTable::set_bool( uint32_t column, bool value ) {
+    set( column, AttributeType::Bool, value ? 1 : 0 );
+  }
+
+  void AttributeTable::set_int( uint32_t column, int64_t value ) {
+    set( column, AttributeType::Int, (uint64_t)value );
+  }
+
+  void AttributeTable::set_double( uint32_t column, double value ) {
+    uint64_t bits;
+    std::memcpy( &bits, &value, sizeof( double ) );
+    set( column, AttributeType::Double, bits );
+  }
+
+  void AttributeTable::set_string( uint32_t column, std::string_view value ) {
+    Column& entry = _columns[column];
+
+    /* checked before the string is stored, a second value would leave it unused */
+    if ( entry.set_rows == _rows )
+      return;
+
+    entry.string_cells++;
+
+    if ( entry.encoded ) {
+      set( column, AttributeType::String, intern( entry, value ) );
+    } else {
+      set( column, AttributeType::String, _string_ends.size() );
+      add_pool_string( value );
+    }
+  }
+
+  uint32_t AttributeTable::intern( Column& column, std::string_view value ) {
+    _lookup.assign( value.data(), value.size() );
+
+    auto it = column.dictionary_index.find( _lookup );
+    if ( it != column.dictionary_index.end() )
+      return it->second;
+
+    uint32_t code = (uint32_t)column.dictionary.size();
+    column.dictionary.push_back( _lookup );
+    column.dictionary_index.emplace( _lookup, code );
+    return code;
+  }
+
+  void AttributeTable::check_encoding( Column& column ) {
+    if ( !column.encoded || column.string_cells < DICTIONARY_SAMPLE )
+      return;
+
+    /* a huge dictionary costs more to hash and to rank than it saves */
+    if ( column.dictionary.size() <= DICTIONARY_MAX_VALUES && column.dictionary.size() * DICTIONARY_RATIO <= column.string_cells )
+      return;
+
+    /* the distinct strings go to the pool once and the codes become indices in it */
+    size_t base = _string_ends.size();
+    for ( const auto& str : column.dictionary )
+      add_pool_string( str );
+
+    for ( size_t row = 0; row < column.types.size(); row++ ) {
+      if ( column.types[row] == AttributeType::String )
+        column.values[row] += base;
+    }
+
+    column.encoded = false;
+    column.dictionary = std::vector<string>();
+    column.dictionary_index = std::unordered_map<string, uint32_t>();
+  }
+
+  void AttributeTable::append( const AttributeTable& other ) {
+    /* add the columns only in `other` first, they start null */
+    std::vector<uint32_t> mapping( other._columns.size() );
+    for ( size_t i = 0; i < other._columns.size(); i++ )
+      mapping[i] = column( other._columns[i].name );
+
+    for ( Column& entry : _columns ) {
+      entry.types.resize( _rows + other._rows, AttributeType::Null );
+      entry.values.resize( _rows + other._rows, 0 );
+    }
+
+    /* strings of the pool of `other` are copied once when first used */
+    std::vector<uint64_t> pool_mapping( other.pool_size(), UINT64_MAX );
+
+    for ( size_t i = 0; i < other._columns.size(); i++ ) {
+      const Column& source = other._columns[i];
+      Column& target = _columns[mapping[i]];
+
+      /* value in the target for a string of `other` */
+      auto add_string = [&] ( std::string_view str ) -> uint64_t {
+        if ( target.encoded )
+          return intern( target, str );
+
+        add_pool_string( str );
+        return _string_ends.size() - 1;
+      };
+
+      /* every code of the source dictionary is translated once */
+      std::vector<uint64_t> codes( source.dictionary.size() );
+      for ( size_t code = 0; code < source.dictionary.size(); code++ )
+        codes[code] = add_string( source.dictionary[code] );
+
+      for ( size_t row = 0; row < other._rows; row++ ) {
+        uint64_t value = source.values[row];
+
+        if ( source.types[row] == AttributeType::String ) {
+          if ( source.encoded ) {
+            value = codes[value];
+          } else if ( target.encoded ) {
+            value = intern( target, other.pool_string( value ) );
+          } else {
+            if ( pool_mapping[value] == UINT64_MAX )
+              pool_mapping[value] = add_string( other.pool_string( value ) );
+            value = pool_mapping[value];
+          }
+        }
+
+        target.types[_rows + row] = source.types[row];
+        target.values[_rows + row] = value;
+      }
+
+      target.string_cells += source.string_cells;
+    }
+
+    _rows += other._rows;
+
+    for ( Column& entry : _columns )
+      check_encoding( entry );
+
+    mark_last_row();
+  }
+
+  void AttributeTable::clear( void ) {
+    _columns.clear();
+    _column_index.clear();
+    _string_chars.clear();
+    _string_ends.clear();
+    _last_row_strings = 0;
+    _last_row_columns = 0;
+    _rows = 0;
+  }
+
+  /* the shortest text that reads back the same double, written the same */
+  /* way as the json writer that formatted the properties before         */
+  static string format_double( double value ) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer( buffer );
+    writer.Double( value );
+    return string( buffer.GetString(), buffer.GetSize() );
+  }
+
+  double AttributeTable::get_double( size_t row, uint32_t column ) const {
+    double value;
+    std::memcpy( &value, &_columns[column].values[row], sizeof( double ) );
+    return value;
+  }
+
+  std::string_view AttributeTable::get_string( size_t row, uint32_t column ) const {
+    const Column& entry = _columns[column];
+    return entry.encoded ? std::string_view( entry.dictionary[entry.values[row]] ) : pool_string( entry.values[row] );
+  }
+
+  std::string_view AttributeTable::pool_string( size_t index ) const {
+    size_t begin = index > 0 ? _string_ends[index - 1] : 0;
+    return std::string_view( _string_chars.data() + begin, _string_ends[index] - begin );
+  }
+
+  void AttributeTable::add_pool_string( std::string_view value ) {
+    _string_chars.append( value.data(), value.size() );
+    _string_ends.push_back( _string_chars.size() );
+  }
+
+  string AttributeTable::to_string( size_t row, uint32_t column ) const {
+    switch ( type( row, column ) ) {
+    case AttributeType::Bool:   return get_bool( row, column ) ? "true" : "false";
+    case AttributeType::Int:    return std::to_string( get_int( row, column ) );
+    case AttributeType::Double: return format_double( get_double( row, column ) );
+    case AttributeType::String: return string( get_string( row, column ) );
+    default:
+      break;
+    }
+
+    return "null";
+  }
+
+  int AttributeTable::compare( size_t a, size_t b, uint32_t column, const std::vector<uint32_t>& ranks ) const {
+    AttributeType type_a = type( a, column );
+    AttributeType type_b = type( b, column );
+
+    /* integers and doubles are ordered together */
+    auto order = [] ( AttributeType type ) -> int {
+      return type == AttributeType::Double ? (int)AttributeType::Int : (int)type;
+    };
+
+    if ( order( type_a ) != order( type_b ) )
+      return order( type_a ) - order( type_b );
+
+    auto sign = [] ( auto x, auto y ) -> int { return ( x > y ) - ( x < y ); };
+
+    switch ( type_a ) {
+    case AttributeType::Bool:
+      return sign( get_bool( a, column ), get_bool( b, column ) );
+    case AttributeType::Int:
+    case AttributeType::Double:
+      if ( type_a == AttributeType::Int && type_b == AttributeType::Int )
+        return sign( get_int( a, column ), get_int( b, column ) );
+      return sign( type_a == AttributeType::Int ? (double)get_int( a, column ) : get_double( a, column ),
+                   type_b == AttributeType::Int ? (double)get_int( b, column ) : get_double( b, column ) );
+    case AttributeType::String:
+      if ( is_dictionary( column ) )
+        return sign( ranks[code( a, column )], ranks[code( b, column )] );
+      return get_string( a, column ).compare( get_string( b, column ) );
+    default:
+      break;
+    }
+
+    return 0;
+  }
+
+  std::vector<uint32_t> AttributeTable::dictionary_ranks( uint32_t column ) const {
+    const auto& dictionary = _columns[column].dictionary;
+
+    std::vector<uint32_t> order( dictionary.size() );
+    std::iota( order.begin(), order.end(), 0 );
+    std::sort( order.begin(), order.end(), [&] ( uint32_t a, uint32_t b ) -> bool {
+      return dictionary[a] < dictionary[b];
+    } );
+
+    std::vector<uint32_t> ranks( dictionary.size() );
+    for ( uint32_t i = 0; i < (uint32_t)order.size(); i++ )
+      ranks[order[i]] = i;
+
+    return ranks;
+  }
+
+  bool AttributeTable::assign( const std::vector<string>& names, const uint64_t* dictionary_sizes, size_t rows, const AttributeType* types,
+                               const uint64_t* values, std::vector<string> strings ) {
+    clear();
+
+    /* the dictionaries are at the end of the strings */
+    size_t pool_size = strings.size();
+    for ( size_t i = 0; i < names.size(); i++ ) {
+      if ( dictionary_sizes[i] > pool_size )
+        return false;
+      pool_size -= dictionary_sizes[i];
+    }
+
+    size_t dictionary_offset = pool_size;
+
+    _columns.resize( names.size() );
+    for ( size_t i = 0; i < names.size(); i++ ) {
+      Column& column = _columns[i];
+      column.name = names[i];
+      column.types.assign( types + i * rows, types + ( i + 1 ) * rows );
+      column.values.assign( values + i * rows, values + ( i + 1 ) * rows );
+
+      column.encoded = dictionary_sizes[i] > 0;
+      for ( size_t code = 0; code < dictionary_sizes[i]; code++ ) {
+        column.dictionary_index.emplace( strings[dictionary_offset + code], (uint32_t)code );
+        column.dictionary.push_back( std::move( strings[dictionary_offset + code] ) );
+      }
+      dictionary_offset += dictionary_sizes[i];
+
+      size_t limit = column.encoded ? column.dictionary.size() : pool_size;
+      for ( size_t row = 0; row < rows; row++ ) {
+        if ( column.types[row] > AttributeType::String ||
+             ( column.types[row] == AttributeType::String && column.values[row] >= limit ) ) {
+          clear();
+          return false;
+        }
+
+        if ( column.types[row] == AttributeType::String )
+          column.string_cells++;
+      }
+
+      _column_index.emplace( column.name, (uint32_t)i );
+    }
+
+    for ( size_t i = 0; i < pool_size; i++ )
+      add_pool_string( strings[i] );
+
+    _rows = rows;
+    mark_last_row();
+    return true;
+  }
+
+}
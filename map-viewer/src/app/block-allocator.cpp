@@ -0,0 +1,92 @@
+#include <app/block-allocator.h>
+
+#include <iterator>
+#include <algorithm>
+
+namespace mv {
+
+  BlockAllocator::BlockAllocator( void ) {} /* do nothing */
+  BlockAllocator::~BlockAllocator( void ) {} /* do nothing */
+
+  void BlockAllocator::reset( size_t size ) {
+    _free.clear();
+    _size = size;
+    _free_size = 0;
+  }
+
+  size_t BlockAllocator::allocate( size_t count ) {
+    if ( count == 0 )
+      return 0;
+
+    for ( auto it = _free.begin(); it != _free.end(); ++it ) {
+      if ( it->second < count )
+        continue;
+
+      /* the rest of the free block stays free */
+      size_t offset = it->first;
+      if ( it->second > count )
+        _free.emplace( offset + count, it->second - count );
+
+      _free.erase( it );
+      _free_size -= count;
+      return offset;
+    }
+
+    /* a free block at the end is grown instead of left behind */
+    if ( !_free.empty() ) {
+      auto last = std::prev( _free.end() );
+
+      if ( last->first + last->second == _size ) {
+        size_t offset = last->first;
+
+        _free_size -= last->second;
+        _free.erase( last );
+        _size = offset + count;
+        return offset;
+      }
+    }
+
+    size_t offset = _size;
+    _size += count;
+    return offset;
+  }
+
+  void BlockAllocator::free( size_t offset, size_t count ) {
+    if ( count == 0 )
+      return;
+
+    _free_size += count;
+
+    /* merge with the free block after it */
+    auto next = _free.lower_bound( offset );
+    if ( next != _free.end() && next->first == offset + count ) {
+      count += next->second;
+      next = _free.erase( next );
+    }
+
+    /* merge with the free block before it */
+    if ( next != _free.begin() ) {
+      auto prev = std::prev( next );
+
+      if ( prev->first + prev->second == offset ) {
+        prev->second += count;
+        return;
+      }
+    }
+
+    _free.emplace_hint( next, offset, count );
+  }
+
+  BlockAllocator::Stats BlockAllocator::stats( void ) const {
+    Stats stats;
+    stats.used = _size - _free_size;
+    stats.free = _free_size;
+    stats.free_blocks = _free.size();
+
+    for ( const auto& [offset, count] : _free )
+      stats.largest_free = std::max( stats.largest_free, count );
+
+    return stats;
+  }
+
+}
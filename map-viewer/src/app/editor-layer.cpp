@@ -66,7 +66,7 @@ namespace mv {
       glm::vec2 delta = Input::mouse_position_delta();
 
       /* scale delta position based on camera z value */
-      glm::vec3 current_pos = _current_geom->get_position( _highlight_vertex );
+      glm::dvec3 current_pos = _current_geom->get_position( _highlight_vertex );
       current_pos.x += delta.x * _current_camera->get_position().z;
       current_pos.y -= delta.y * _current_camera->get_position().z;
 
@@ -81,7 +81,7 @@ namespace mv {
 
     /* handle vertex addition */
     if ( _is_over_edge && Input::is_key_down( KEY_A ) && Input::is_mouse_button_pressed( MOUSE_BUTTON_LEFT ) ) {
-      glm::vec3 mouse_pos = glm::vec3( _current_camera->get_mouse_world_pos(), 0.0f );
+      glm::dvec3 mouse_pos = glm::dvec3( _current_camera->get_mouse_world_pos(), 0.0 );
 
       _current_geom->insert( _highlight_edge + 1, mouse_pos );
     }
@@ -94,6 +94,15 @@ namespace mv {
     vertex_index vert = 0;
     vertex_index edge = 0;
 
+    /* the vertices are drawn relative to the geometry so that they */
+    /* do not lose precision when converted to float                */
+    glm::dvec3 origin = _current_geom->bbox().center();
+    origin.z = 0.0;
+
+    auto relative = [&] ( const glm::dvec3& position ) -> glm::vec3 {
+      return glm::vec3( position - origin );
+    };
+
     /* set point and line sizes */
     RenderState::ref().set_point_size( _point_size );
     RenderState::ref().set_line_thickenss( _line_thickness );
@@ -117,11 +126,11 @@ namespace mv {
             next = 0;
 
           if ( _is_over_edge && vertex_id == _highlight_edge ) {
-            Immgfx::ref().push_vertex( sub_polygon.get_position( current ), _line_highlight_color );
-            Immgfx::ref().push_vertex( sub_polygon.get_position( next ), _line_highlight_color );
+            Immgfx::ref().push_vertex( relative( sub_polygon.get_position( current ) ), _line_highlight_color );
+            Immgfx::ref().push_vertex( relative( sub_polygon.get_position( next ) ), _line_highlight_color );
           }           else {
-            Immgfx::ref().push_vertex( sub_polygon.get_position( current ), _line_color );
-            Immgfx::ref().push_vertex( sub_polygon.get_position( next ), _line_color );
+            Immgfx::ref().push_vertex( relative( sub_polygon.get_position( current ) ), _line_color );
+            Immgfx::ref().push_vertex( relative( sub_polygon.get_position( next ) ), _line_color );
           }
 
           vertex_id++;
@@ -130,7 +139,7 @@ namespace mv {
     }
 
     /* draw edges */
-    Immgfx::ref().draw( _current_camera, Topology::Line );
+    Immgfx::ref().draw( _current_camera->projection(), _current_camera->view( origin ), Topology::Line );
 
     /* get the edge index */
     edge = Immgfx::ref().get_primitive_id( Input::mouse_position().x, _window_size.y - Input::mouse_position().y );
@@ -141,13 +150,13 @@ namespace mv {
     /* submit vertices and also handle highlight */
     for ( size_t i = 0; i < _current_geom->vertices(); i++ ) {
       if ( _is_over_vertex && i == _highlight_vertex )
-        Immgfx::ref().push_vertex( _current_geom->get_position( i ), _point_highlight_color );
+        Immgfx::ref().push_vertex( relative( _current_geom->get_position( i ) ), _point_highlight_color );
       else
-        Immgfx::ref().push_vertex( _current_geom->get_position( i ), _point_color );
+        Immgfx::ref().push_vertex( relative( _current_geom->get_position( i ) ), _point_color );
     }
 
     /* draw the vertices */
-    Immgfx::ref().draw( _current_camera, Topology::Point );
+    Immgfx::ref().draw( _current_camera->projection(), _current_camera->view( origin ), Topology::Point );
 
     /* get the vertex index */
     vert = Immgfx::ref().get_primitive_id( Input::mouse_position().x, _window_size.y - Input::mouse_position().y );
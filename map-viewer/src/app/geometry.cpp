@@ -1,6 +1,7 @@
 #include <app/geometry.h>
 
 #include <limits>
+#include <algorithm>
 
 #include <utils/logger.h>
 #include <utils/assert.h>
@@ -9,313 +10,210 @@ namespace mv {
 
   /* ---------- SUB POLYGON ---------- */
 
-  SubPolygon::SubPolygon( void ) {} /* do nothing */
-
-  SubPolygon::~SubPolygon( void ) {} /* do nothing */
-
-  void SubPolygon::update( vertex_index index, const glm::vec3& position ) {
+  glm::dvec3 SubPolygon::get_position( vertex_index index ) const {
 
     /* return if the index is invalid */
     if ( index >= _vertices ) {
-      LOG_ERROR( "the sub-polygon only has {} vertices, cannot update vertex at index: {}", _vertices, index );
-      return;
+      THROW( "failed to get sub-polygon position at invalid index; index out of bounds" );
     }
 
-    /* update the position at specified index */
-    _positions[index] = position;
-    _is_updated = true;
+    return _positions[index];
   }
 
-  void SubPolygon::insert( vertex_index offset, const glm::vec3& position ) {
-
-    /* return if the offset is invalid */
-    if ( offset > _vertices ) {
-      LOG_ERROR( "the sub-polygon only has {} vertices, cannot insert vertex at offset: {}", _vertices, offset );
-      return;
-    }
+  /* ---------- POLYGON ---------- */
 
-    /* insert a new vertex at offset */
-    _positions.insert( _positions.begin() + offset, position );
+  SubPolygon Polygon::sub_polygon( uint32_t index ) const {
+    uint32_t ring = _first_ring + index;
+    vertex_index offset = _geometry->_ring_offsets[ring];
 
-    /* update the size of vertices */
-    _vertices++;
-    _is_updated = true;
+    return SubPolygon( _geometry->_positions.data() + offset, _geometry->_ring_offsets[ring + 1] - offset );
   }
 
-  void SubPolygon::push_back( const glm::vec3& position ) {
-
-    _positions.push_back( position );
-
-    /* update the size of vertices */
-    _vertices++;
-    _is_updated = true;
+  uint32_t Polygon::vertices( void ) const {
+    return _geometry->_ring_offsets[_last_ring] - _geometry->_ring_offsets[_first_ring];
   }
 
-  void SubPolygon::remove( vertex_index index ) {
-
-    /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      LOG_ERROR( "the sub-polygon only has {} vertices, cannot remove vertex at index: {}", _vertices, index );
-      return;
-    }
-
-    /* remove the vertex at index */
-    _positions.erase( _positions.begin() + index );
-
-    /* update the size of vertices */
-    _vertices--;
-    _is_updated = true;
+  vertex_index Polygon::vertex_offset( void ) const {
+    return _geometry->_ring_offsets[_first_ring];
   }
 
-  glm::vec3 SubPolygon::get_position( vertex_index index ) const {
-
-    /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      THROW( "failed to get sub-polygon position at invalid index; index out of bounds" );
-    }
-
-    return _positions[index];
-  }
+  /* ---------- GEOMETRY ---------- */
 
-  /* ---------- POLYGON ---------- */
+  Geometry::Geometry( void ) : _id( 0 ) {}
 
-  Polygon::Polygon( void ) {} /* do nothing */
+  Geometry::Geometry( const std::vector<glm::dvec3>& positions, const std::vector<vertex_index>& ring_offsets, const std::vector<uint32_t>& polygon_offsets ) :
+    _positions( positions ), _ring_offsets( ring_offsets ), _polygon_offsets( polygon_offsets ), _id( 0 ) {}
 
-  Polygon::~Polygon( void ) {} /* do nothing */
+  Geometry::~Geometry( void ) {} /* do nothing */
 
-  void Polygon::update( vertex_index index, const glm::vec3& position ) {
+  void Geometry::update( vertex_index index, const glm::dvec3& position ) {
 
     /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot update vertex at index: {}", _vertices, index );
+    if ( index >= vertices() ) {
+      LOG_ERROR( "the polygon only has {} vertices, cannot update vertex at index: {}", vertices(), index );
       return;
     }
 
-    /* iterate over all the sub-polygons to find the correct index */
-    for ( auto& sub_polygon : _sub_polygons ) {
-      if ( index >= sub_polygon.vertices() ) {
-        index -= sub_polygon.vertices();
-        continue;
-      }
-
-      /* update the correct index vertex for the sub-polygon */
-      sub_polygon.update( index, position );
-      break;
-    }
+    /* the index is the position in the array */
+    _positions[index] = position;
+    mark_dirty( polygon_of( index ) );
   }
 
-  void Polygon::insert( vertex_index offset, const glm::vec3& position ) {
+  void Geometry::insert( vertex_index offset, const glm::dvec3& position ) {
 
     /* return if the index is invalid */
-    if ( offset > _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot insert vertex at offset: {}", _vertices, offset );
+    if ( offset > vertices() || _ring_offsets.size() < 2 ) {
+      LOG_ERROR( "the polygon only has {} vertices, cannot insert vertex at offset: {}", vertices(), offset );
       return;
     }
 
-    /* iterate over all the sub-polygons to find the correct index */
-    for ( auto& sub_polygon : _sub_polygons ) {
-      if ( offset > sub_polygon.vertices() ) {
-        offset -= sub_polygon.vertices();
-        continue;
-      }
+    /* the vertex goes to the first sub-polygon ending at or after `offset`, */
+    /* so an offset at the end of a sub-polygon appends to that sub-polygon  */
+    auto ring = std::lower_bound( _ring_offsets.begin() + 1, _ring_offsets.end(), offset );
+    _positions.insert( _positions.begin() + offset, position );
 
-      /* insert the vertex at the correct index for the sub-polygon */
-      sub_polygon.insert( offset, position );
-      break;
-    }
+    /* `ring` is the end of the sub-polygon getting the vertex */
+    mark_dirty( polygon_of_sub_polygon( (uint32_t)( ring - _ring_offsets.begin() ) - 1 ) );
 
-    /* update the number of vertices */
-    _vertices++;
+    /* the sub-polygons after it start one vertex later */
+    for ( ; ring != _ring_offsets.end(); ++ring )
+      ( *ring )++;
   }
 
-  void Polygon::remove( vertex_index index ) {
+  void Geometry::remove( vertex_index index ) {
 
     /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot remove vertex at index: {}", _vertices, index );
+    if ( index >= vertices() ) {
+      LOG_ERROR( "the polygon only has {} vertices, cannot remove vertex at index: {}", vertices(), index );
       return;
     }
 
-    /* iterate over all the sub-polygons to find the correct index */
-    for ( auto& sub_polygon : _sub_polygons ) {
-      if ( index >= sub_polygon.vertices() ) {
-        index -= sub_polygon.vertices();
-        continue;
-      }
+    /* the polygon is found before the offsets move, the last vertex */
+    /* of a sub-polygon would belong to the next one afterwards      */
+    uint32_t ring = sub_polygon_of( index );
+    mark_dirty( polygon_of_sub_polygon( ring ) );
 
-      /* update the correct index vertex for the sub-polygon */
-      sub_polygon.remove( index );
-      break;
-    }
+    /* the sub-polygons after the one with the vertex start one vertex earlier */
+    for ( size_t i = ring + 1; i < _ring_offsets.size(); i++ )
+      _ring_offsets[i]--;
 
-    /* update the number of vertices */
-    _vertices--;
+    _positions.erase( _positions.begin() + index );
   }
 
-  void Polygon::push_back( const SubPolygon& sub_polygon ) {
+  void Geometry::push_sub_polygon( const glm::dvec3* positions, uint32_t count ) {
 
     /* do not add empty sub-polygon */
-    if ( sub_polygon.vertices() == 0 ) {
+    if ( count == 0 ) {
       LOG_WARN( "trying to insert empty sub-polygon; cannot continute" );
       return;
     }
 
-    /* inser the sub-polygon to the list */
-    _sub_polygons.push_back( sub_polygon );
-
-    /* update the number of vertices */
-    _vertices += sub_polygon.vertices();
-  }
-
-  glm::vec3 Polygon::get_position( vertex_index index ) const {
-
-    if ( index >= _vertices ) {
-      THROW( "failed to get polygon position at invalid index; index out of bounds" );
-    }
-
-    /* iterate over all the sub-polygons to find the correct index */
-    for ( auto& sub_polygon : _sub_polygons ) {
-      if ( index >= sub_polygon.vertices() ) {
-        index -= sub_polygon.vertices();
-        continue;
-      }
-
-      /* update the correct index vertex for the sub-polygon */
-      return sub_polygon.get_position( index );
-      break;
-    }
-
-    /* to remove warning; this should never be executed */
-    THROW( "fatal error" );
-    return glm::vec3( 0.0f );
+    _positions.insert( _positions.end(), positions, positions + count );
+    _ring_offsets.push_back( (vertex_index)_positions.size() );
   }
 
-  /* ---------- GEOMETRY ---------- */
-
-  Geometry::Geometry( void ) : _id( 0 ) {}
-
-  Geometry::~Geometry( void ) {} /* do nothing */
-
-  void Geometry::update( vertex_index index, const glm::vec3& position ) {
+  void Geometry::end_polygon( void ) {
+    uint32_t rings = (uint32_t)_ring_offsets.size() - 1;
 
-    /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot update vertex at index: {}", _vertices, index );
+    /* do not add empty polygon */
+    if ( rings == _polygon_offsets.back() ) {
+      LOG_WARN( "trying to insert empty sub-polygon; cannot continute" );
       return;
     }
 
-    /* iterate over all the polygons to find the correct index */
-    for ( auto& polygon : _polygons ) {
-      if ( index >= polygon.vertices() ) {
-        index -= polygon.vertices();
-        continue;
-      }
-
-      /* update the correct index vertex for the polygon */
-      polygon.update( index, position );
-      break;
-    }
+    _polygon_offsets.push_back( rings );
   }
 
-  void Geometry::insert( vertex_index offset, const glm::vec3& position ) {
+  glm::dvec3 Geometry::get_position( vertex_index index ) const {
 
-    /* return if the index is invalid */
-    if ( offset > _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot insert vertex at offset: {}", _vertices, offset );
-      return;
+    if ( index >= vertices() ) {
+      THROW( "failed to get polygon position at invalid index; index out of bounds" );
     }
 
-    /* iterate over all the polygons to find the correct index */
-    for ( auto& polygon : _polygons ) {
-      if ( offset > polygon.vertices() ) {
-        offset -= polygon.vertices();
-        continue;
-      }
+    return _positions[index];
+  }
 
-      /* insert the vertex at the correct index for the polygons */
-      polygon.insert( offset, position );
-      break;
-    }
+  uint32_t Geometry::sub_polygon_of( vertex_index index ) const {
+    /* last sub-polygon starting at or before `index`, empty ones are skipped */
+    auto ring = std::upper_bound( _ring_offsets.begin(), _ring_offsets.end(), index );
+    return (uint32_t)( ring - _ring_offsets.begin() ) - 1;
+  }
 
-    /* update the number of vertices */
-    _vertices++;
+  uint32_t Geometry::polygon_of( vertex_index index ) const {
+    return polygon_of_sub_polygon( sub_polygon_of( index ) );
   }
 
-  void Geometry::remove( vertex_index index ) {
+  uint32_t Geometry::polygon_of_sub_polygon( uint32_t ring ) const {
+    /* last polygon starting at or before `ring` */
+    auto polygon = std::upper_bound( _polygon_offsets.begin(), _polygon_offsets.end(), ring );
+    return (uint32_t)( polygon - _polygon_offsets.begin() ) - 1;
+  }
 
-    /* return if the index is invalid */
-    if ( index >= _vertices ) {
-      LOG_ERROR( "the polygon only has {} vertices, cannot remove vertex at index: {}", _vertices, index );
+  void Geometry::mark_dirty( uint32_t polygon ) {
+    /* a vertex outside of the finished polygons is not drawn */
+    if ( polygon >= polygons() )
       return;
-    }
-
-    /* iterate over all the polygons to find the correct index */
-    for ( auto& polygon : _polygons ) {
-      if ( index >= polygon.vertices() ) {
-        index -= polygon.vertices();
-        continue;
-      }
 
-      /* update the correct index vertex for the polygons */
-      polygon.remove( index );
-      break;
-    }
-
-    /* update the number of vertices */
-    _vertices--;
+    auto it = std::lower_bound( _dirty_polygons.begin(), _dirty_polygons.end(), polygon );
+    if ( it == _dirty_polygons.end() || *it != polygon )
+      _dirty_polygons.insert( it, polygon );
   }
 
-  void Geometry::push_back( const Polygon& polygon ) {
-
-    /* do not add empty polygon */
-    if ( polygon.vertices() == 0 ) {
-      LOG_WARN( "trying to insert empty sub-polygon; cannot continute" );
-      return;
-    }
+  void Geometry::compute_bbox( void ) {
 
-    /* insert the polygon to the list */
-    _polygons.push_back( polygon );
+    /* create an empty bounding box */
+    _bounding_box = Box();
 
-    /* update the number of vertices */
-    _vertices += polygon.vertices();
+    /* includ all the vertices to the bounding box */
+    _bounding_box.include( _positions.data(), _positions.size() );
   }
 
-  glm::vec3 Geometry::get_position( vertex_index index ) const {
+  bool Geometry::contains( const glm::dvec2& point ) const {
+    for ( uint32_t polygon = 0; polygon < polygons(); polygon++ ) {
+      bool inside = false;
 
-    if ( index >= _vertices ) {
-      THROW( "failed to get polygon position at invalid index; index out of bounds" );
-    }
+      /* every edge crossed by the ray from `point` towards +x flips the side */
+      for ( uint32_t ring = _polygon_offsets[polygon]; ring < _polygon_offsets[polygon + 1]; ring++ ) {
+        vertex_index first = _ring_offsets[ring], last = _ring_offsets[ring + 1];
+
+        for ( vertex_index i = first, j = last - 1; i < last; j = i++ ) {
+          const glm::dvec3& a = _positions[i];
+          const glm::dvec3& b = _positions[j];
 
-    /* iterate over all the polygons to find the correct index */
-    for ( auto& polygon : _polygons ) {
-      if ( index >= polygon.vertices() ) {
-        index -= polygon.vertices();
-        continue;
+          if ( ( a.y > point.y ) != ( b.y > point.y ) && point.x < a.x + ( b.x - a.x ) * ( point.y - a.y ) / ( b.y - a.y ) )
+            inside = !inside;
+        }
       }
 
-      /* update the correct index vertex for the polygon */
-      return polygon.get_position( index );
-      break;
+      if ( inside )
+        return true;
     }
 
-    /* to remove warning; this should never be executed */
-    THROW( "fatal error" );
-    return glm::vec3( 0.0f );
+    return false;
   }
 
-  void Geometry::compute_bbox( void ) {
+  double Geometry::outline_distance2( const glm::dvec2& point ) const {
+    double closest = std::numeric_limits<double>::max();
 
-    /* create an empty bounding box */
-    _bounding_box = Box();
+    for ( uint32_t ring = 0; ring + 1 < _ring_offsets.size(); ring++ ) {
+      vertex_index first = _ring_offsets[ring], last = _ring_offsets[ring + 1];
 
-    /* includ all the vertices to the bounding box */
-    for ( const auto& polygon : _polygons ) {
-      for ( const auto& sub_polygon : polygon ) {
-        for ( const auto& position : sub_polygon ) {
-          _bounding_box.include( position );
-        }
+      /* the last vertex of a sub-polygon connects back to the first */
+      for ( vertex_index i = first, j = last - 1; i < last; j = i++ ) {
+        glm::dvec2 a = glm::dvec2( _positions[j] );
+        glm::dvec2 edge = glm::dvec2( _positions[i] ) - a;
+        glm::dvec2 offset = point - a;
+
+        /* project on the edge and clamp to its ends */
+        double length2 = glm::dot( edge, edge );
+        double t = length2 > 0.0 ? glm::clamp( glm::dot( offset, edge ) / length2, 0.0, 1.0 ) : 0.0;
+
+        offset -= t * edge;
+        closest = std::min( closest, glm::dot( offset, offset ) );
       }
     }
+
+    return closest;
   }
 
 }
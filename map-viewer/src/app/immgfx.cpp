@@ -1,25 +1,37 @@
 #include <app/immgfx.h>
 
+#include <cstring>
+
 #include <core/window.h>
 
 namespace mv {
 
+  /* the vertices are copied as they are to the buffer of `Position3` and `Color4` */
+  static_assert( sizeof( Immgfx::Vertex ) == 7 * sizeof( float ), "Immgfx::Vertex must match the vertex buffer" );
+
+  /* fixed locations of the uniforms of the shader below */
+  constexpr UniformLocation VIEW_PROJECTION_UNIFORM = { 0 };
+  constexpr UniformLocation FIRST_VERTEX_UNIFORM    = { 1 };
+
   constexpr char immgfx_vs[] = R"(
     #version 460 core
   
     layout ( location = 0 ) in vec3 a_position;
     layout ( location = 1 ) in vec4 a_color;
   
-    uniform mat4 projection;
-    uniform mat4 view;
+    /* projection times view, multiplied once per draw instead of per vertex */
+    layout ( location = 0 ) uniform mat4 view_projection;
+
+    /* the batches share the buffer, the ids start at the first vertex of the batch */
+    layout ( location = 1 ) uniform int first_vertex;
   
     out vec4 pass_color;
     flat out uint vertex_id;
 
     void main() {
-      vertex_id = uint( gl_VertexID );
+      vertex_id = uint( gl_VertexID - first_vertex );
       pass_color = a_color;
-      gl_Position = projection * view * vec4( a_position, 1.0f );
+      gl_Position = view_projection * vec4( a_position, 1.0f );
     }
   )";
 
@@ -56,10 +68,13 @@ namespace mv {
     _framebuffer->set_color_attachment( _color_attachment, 0 );
     _framebuffer->set_color_attachment( _primitive_id_attachment, 1 );
 
-    _vertices = new VertexBuffer<Position3, Color4>( MAX_VERTICES, nullptr );
+    _vertices = new VertexBuffer<Position3, Color4>( SECTIONS * _section_size, nullptr, BufferUsage::Persistent );
   }
 
-  Immgfx::~Immgfx( void ) {} /* do nothing */
+  Immgfx::~Immgfx( void ) {
+    for ( void* fence : _fences )
+      delete_fence( fence );
+  }
 
   void Immgfx::bind( void ) {
     PROFILE_FUNCTION();
@@ -80,15 +95,24 @@ namespace mv {
     /* clear the id texture with 0 regarless of clearColor */
     _primitive_id_attachment->clear( 0 );
 
-    /* map the vertex buffer to modify it */
-    _vertices->map();
+    _batch.clear();
   }
 
   void Immgfx::draw( Ref<OrthoCamera> camera, Topology topology ) {
+    draw( camera->projection(), camera->view(), topology );
+  }
+
+  void Immgfx::draw( const glm::mat4& projection, const glm::mat4& view, Topology topology ) {
     PROFILE_FUNCTION();
 
-    /* unmap the vertex buffer before drawing to upload data to GPU */
-    _vertices->unmap();
+    /* the batch is written to the mapping in one go, it is coherent */
+    /* so the vertices are visible to the GPU with the draw below    */
+    size_t count = _batch.size();
+    size_t first = reserve( count );
+
+    if ( count > 0 )
+      memcpy( _vertices->mapped_buffer() + first * sizeof( Vertex ), _batch.data(), count * sizeof( Vertex ) );
+    _head = first + count;
 
     /* draw the contents using topology */
     RenderState::ref().push_topology( topology );
@@ -96,53 +120,65 @@ namespace mv {
       _shader->set_input_buffers( _vertices );
       _shader->use();
 
-      _shader->set_mat4( "projection", camera->projection() );
-      _shader->set_mat4( "view", camera->view() );
+      _shader->set_mat4( VIEW_PROJECTION_UNIFORM, projection * view );
+      _shader->set_int( FIRST_VERTEX_UNIFORM, (int32_t)first );
 
-      RenderState::ref().draw( _vertex_index );
+      RenderState::ref().draw( (uint32_t)count, (uint32_t)first );
     }
     RenderState::ref().pop_topology();
 
-    _vertex_index = 0;
+    _batch.clear();
   }
 
-  void Immgfx::draw( const glm::mat4& projection, const glm::mat4& view, Topology topology ) {
-    PROFILE_FUNCTION();
+  void Immgfx::push_vertex( glm::vec3 position, glm::vec4 color ) {
+    _batch.push_back( { position, color } );
+  }
+
+  void Immgfx::push_vertices( const Vertex* vertices, size_t count ) {
+    _batch.insert( _batch.end(), vertices, vertices + count );
+  }
 
-    /* unmap the vertex buffer before drawing to upload data to GPU */
-    _vertices->unmap();
+  size_t Immgfx::reserve( size_t count ) {
+    if ( count > _section_size ) {
+      grow( count );
+      return _head;
+    }
 
-    /* draw the contents using topology */
-    RenderState::ref().push_topology( topology );
-    {
-      _shader->set_input_buffers( _vertices );
-      _shader->use();
+    if ( _head + count <= ( _section + 1 ) * _section_size )
+      return _head;
 
-      _shader->set_mat4( "projection", projection );
-      _shader->set_mat4( "view", view );
+    /* the draws so far are the last ones from the section, the next */
+    /* section is written once the GPU is done with its own draws    */
+    _fences[_section] = create_fence();
+    _section = ( _section + 1 ) % SECTIONS;
 
-      RenderState::ref().draw( _vertex_index );
-    }
-    RenderState::ref().pop_topology();
+    wait_fence( _fences[_section] );
+    _fences[_section] = nullptr;
 
-    _vertex_index = 0;
+    _head = _section * _section_size;
+    return _head;
   }
 
-  void Immgfx::push_vertex( glm::vec3 position, glm::vec4 color ) {
-    struct pc {
-      Position3 pos;
-      Color4 col;
-    };
+  void Immgfx::grow( size_t section_size ) {
+    PROFILE_FUNCTION();
 
-    /* push the vertex position along with color */
-    pc p;
-    p.pos = { position.x, position.y, position.z };
-    p.col = { color.r, color.g, color.b, color.a };
+    while ( _section_size < section_size )
+      _section_size *= 2;
+
+    Ref<VertexBuffer<Position3, Color4>> vertices = new VertexBuffer<Position3, Color4>( SECTIONS * _section_size, nullptr, BufferUsage::Persistent );
+
+    /* the new buffer has no draws to wait for, OpenGL  */
+    /* deletes the old one once the GPU is done with it */
+    for ( void*& fence : _fences ) {
+      delete_fence( fence );
+      fence = nullptr;
+    }
 
-    auto buff = _vertices->mapped_buffer();
-    memcpy( buff + _vertices->vertex_size() * _vertex_index, &p, _vertices->vertex_size() );
+    LOG_INFO( "grew the immgfx buffer to {} vertices per section", _section_size );
 
-    _vertex_index++;
+    _vertices = vertices;
+    _section = 0;
+    _head = 0;
   }
 
   uint32_t Immgfx::get_primitive_id( uint32_t x, uint32_t y ) {
@@ -0,0 +1,169 @@
+#include <app/layer-cache.h>
+
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#include <utils/logger.h>
+
+namespace mv {
+
+  /* every section starts at a multiple of this */
+  static constexpr size_t CACHE_ALIGNMENT = 16;
+
+  static constexpr char CACHE_MAGIC[8] = { 'M', 'V', 'C', 'A', 'C', 'H', 'E', '\0' };
+
+  struct CacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t num_sections;
+
+    /* the source the cache was made from */
+    uint64_t source_size;
+    int64_t  source_mtime;
+
+    /* offset from the start of the file and size in bytes of every section */
+    uint64_t offsets[(size_t)LayerCache::Section::Count];
+    uint64_t sizes[(size_t)LayerCache::Section::Count];
+  };
+
+  static inline size_t align_offset( size_t offset ) {
+    return ( offset + CACHE_ALIGNMENT - 1 ) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+  }
+
+  /* size and modification time of the source, false if it does not exist */
+  static bool source_stamp( const string& source, uint64_t& size, int64_t& mtime ) {
+    std::error_code error;
+
+    size = (uint64_t)std::filesystem::file_size( source, error );
+    if ( error )
+      return false;
+
+    mtime = (int64_t)std::filesystem::last_write_time( source, error ).time_since_epoch().count();
+    return !error;
+  }
+
+  LayerCache::LayerCache( void ) {
+    _sections.fill( std::make_pair( nullptr, 0 ) );
+  }
+
+  LayerCache::~LayerCache( void ) {} /* do nothing */
+
+  bool LayerCache::open( const string& source ) {
+    _sections.fill( std::make_pair( nullptr, 0 ) );
+
+    uint64_t source_size;
+    int64_t  source_mtime;
+    if ( !source_stamp( source, source_size, source_mtime ) )
+      return false;
+
+    /* a missing cache is not an error */
+    string path = cache_path( source );
+    std::error_code error;
+    if ( !std::filesystem::exists( path, error ) )
+      return false;
+
+    _file.open( path, DataFile::Mode::Mapped );
+    if ( !_file )
+      return false;
+
+    if ( _file.size() < sizeof( CacheHeader ) ) {
+      LOG_WARN( "layer cache `{}` is truncated; ignoring", path );
+      _file.close();
+      return false;
+    }
+
+    CacheHeader header;
+    std::memcpy( &header, _file.view().data(), sizeof( CacheHeader ) );
+
+    if ( std::memcmp( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) != 0 ||
+         header.version != VERSION || header.num_sections != (uint32_t)Section::Count ) {
+      LOG_WARN( "layer cache `{}` is from another version; ignoring", path );
+      _file.close();
+      return false;
+    }
+
+    if ( header.source_size != source_size || header.source_mtime != source_mtime ) {
+      LOG_INFO( "layer cache `{}` is stale; ignoring", path );
+      _file.close();
+      return false;
+    }
+
+    for ( size_t i = 0; i < (size_t)Section::Count; i++ ) {
+      if ( header.offsets[i] > _file.size() || header.sizes[i] > _file.size() - header.offsets[i] ) {
+        LOG_WARN( "layer cache `{}` is truncated; ignoring", path );
+        _file.close();
+        return false;
+      }
+
+      _sections[i] = std::make_pair( _file.view().data() + header.offsets[i], (size_t)header.sizes[i] );
+    }
+
+    return true;
+  }
+
+  bool LayerCache::write( const string& source ) const {
+    CacheHeader header = {};
+    std::memcpy( header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+    header.version = VERSION;
+    header.num_sections = (uint32_t)Section::Count;
+
+    if ( !source_stamp( source, header.source_size, header.source_mtime ) )
+      return false;
+
+    /* the sections are laid one after the other after the header */
+    size_t offset = align_offset( sizeof( CacheHeader ) );
+    for ( size_t i = 0; i < (size_t)Section::Count; i++ ) {
+      header.offsets[i] = offset;
+      header.sizes[i] = _sections[i].second;
+      offset = align_offset( offset + _sections[i].second );
+    }
+
+    /* write to a temporary file and move it over the cache when complete, */
+    /* so that a cache is never seen half written                          */
+    string path = cache_path( source );
+    string temp_path = path + ".tmp";
+
+    {
+      std::ofstream file( temp_path, std::ios::out | std::ios::binary | std::ios::trunc );
+      if ( !file ) {
+        LOG_WARN( "failed to create layer cache: {}", path );
+        return false;
+      }
+
+      static const char padding[CACHE_ALIGNMENT] = {};
+
+      file.write( reinterpret_cast<const char*>( &header ), sizeof( CacheHeader ) );
+      file.write( padding, align_offset( sizeof( CacheHeader ) ) - sizeof( CacheHeader ) );
+
+      for ( const auto& section : _sections ) {
+        if ( section.second > 0 )
+          file.write( section.first, section.second );
+        file.write( padding, align_offset( section.second ) - section.second );
+      }
+
+      if ( !file ) {
+        LOG_WARN( "failed to write layer cache: {}", path );
+        file.close();
+        std::error_code error;
+        std::filesystem::remove( temp_path, error );
+        return false;
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename( temp_path, path, error );
+    if ( error ) {
+      LOG_WARN( "failed to write layer cache: {}", path );
+      std::filesystem::remove( temp_path, error );
+      return false;
+    }
+
+    return true;
+  }
+
+  string LayerCache::cache_path( const string& source ) {
+    return source + ".mvcache";
+  }
+
+}
@@ -0,0 +1,107 @@
+#include <app/layer-loader.h>
+
+#include <exception>
+
+#include <utils/logger.h>
+#include <debug/profiler.h>
+
+namespace mv {
+
+  LayerLoader::LayerLoader( const string& filename ) : _filename( filename ) {
+    PROFILE_FUNCTION();
+
+    _state = std::make_shared<State>();
+    _state->filename = filename;
+
+    auto task = [state = _state] () -> void {
+      /* a raw pointer, the count of the layer is only ever touched on the GL thread */
+      MapLayer* layer = nullptr;
+
+      try {
+        layer = new MapLayer( state->filename, &state->progress );
+      } catch ( const std::exception& e ) {
+        LOG_ERROR( "failed to load layer `{}`: {}", state->filename, e.what() );
+      }
+
+      std::lock_guard<std::mutex> lock( state->mutex );
+
+      /* nobody is waiting for a cancelled layer */
+      if ( state->progress.cancelled ) {
+        delete layer;
+        layer = nullptr;
+      }
+
+      state->layer = layer;
+      state->finished = true;
+    };
+
+    /* without the pool the layer is loaded right here */
+    if ( ThreadPool* pool = ThreadPool::get() )
+      pool->submit( task );
+    else
+      task();
+  }
+
+  LayerLoader::~LayerLoader( void ) {
+    cancel();
+  }
+
+  LayerLoader::Stage LayerLoader::update( size_t budget ) {
+    PROFILE_FUNCTION();
+
+    if ( _stage == Stage::Parsing ) {
+      std::lock_guard<std::mutex> lock( _state->mutex );
+
+      if ( !_state->finished )
+        return _stage;
+
+      /* take over the layer from the task, it is only safe to reference   */
+      /* it here under the mutex which the task released after building it */
+      _layer = _state->layer;
+      _state->layer = nullptr;
+
+      if ( _layer == nullptr || _layer->empty() ) {
+        _layer = nullptr;
+        _stage = Stage::Failed;
+        return _stage;
+      }
+
+      _stage = Stage::Uploading;
+    }
+
+    if ( _stage == Stage::Uploading && _layer->upload( budget ) )
+      _stage = Stage::Done;
+
+    return _stage;
+  }
+
+  void LayerLoader::cancel( void ) {
+    if ( _stage != Stage::Parsing && _stage != Stage::Uploading )
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock( _state->mutex );
+      _state->progress.cancelled = true;
+
+      /* the task finished but the layer was never taken */
+      delete _state->layer;
+      _state->layer = nullptr;
+    }
+
+    _layer = nullptr;
+    _stage = Stage::Cancelled;
+  }
+
+  float LayerLoader::progress( void ) const {
+    switch ( _stage ) {
+    case Stage::Parsing:   return _state->progress.fraction();
+    case Stage::Uploading: return _layer->upload_progress();
+    case Stage::Done:      return 1.0f;
+    default:
+      break;
+    }
+
+    return 0.0f;
+  }
+
+}
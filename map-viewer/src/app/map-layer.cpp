@@ -1,52 +1,102 @@
 #include <app/map-layer.h>
 
-#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 
-#include <app/earcut.h>
 #include <app/geojson-loader.h>
+#include <app/layer-cache.h>
+#include <app/simplifier.h>
 
 namespace mv {
 
-  MapLayer::MapLayer( const string& filename ) {
-    PROFILE_FUNCTION();
+  /* number of geometries simplified by one task while building the levels */
+  static constexpr size_t LOD_CHUNK_GEOMETRIES = 512;
 
-    /* load geometries from geojson */
-    _geometries = load_geojson_to_buffer( filename );
+  /* weather [offset, offset + count) is inside an array of `size` elements */
+  static bool in_bounds( uint64_t offset, uint64_t count, size_t size ) {
+    return count <= size && offset <= size - count;
+  }
 
-    /* return if not able to load the file */
-    if ( _geometries.empty() ) {
-      return;
-    }
+  /* Write `count` elements of `data` to the block of a geometry in `buffer`. */
+  /* The block is written over when it does not grow and its end is given     */
+  /* back, otherwise the block moves to a free one which may be past the end  */
+  /* of the buffer. Returns true if the block moved or changed its size.      */
+  template<typename Buffer, typename T>
+  static bool write_block( Buffer& buffer, BlockAllocator& blocks, uint64_t& offset, uint64_t& size, size_t count, const T* data ) {
+    bool changed = count != size;
+
+    if ( count <= size ) {
+      buffer.set_range( offset, count, data );
+      blocks.free( offset + count, size - count );
+    } else {
+      size_t buffer_size = blocks.size();
 
-    /* set the ids */
-    for ( auto& geom : _geometries ) {
-      /* yes the first geometry will have id = 1, this is to */
-      /* make 0 as invalid id                                */
-      geom->set_id( ++_unique_id );
+      blocks.free( offset, size );
+      offset = blocks.allocate( count );
+
+      /* the part past the end grows the buffer */
+      size_t inside = std::min<size_t>( count, buffer_size - offset );
+      buffer.set_range( offset, inside, data );
+
+      if ( inside < count )
+        buffer.replace( buffer_size, 0, count - inside, const_cast<T*>( data + inside ) );
+
+      changed = true;
     }
 
-    /* combined vertices and outlines for all the polygons in the file */
-    std::vector<MapLayer::Vertex> combined_vertices;
-    std::vector<glm::vec3> combined_outlines;
+    size = count;
+    return changed;
+  }
 
-    for ( const auto& geometry : _geometries ) {
-      /* compute triangulated vertices and outlines for the geometry */
-      auto vertices = make_polygon_buffer( geometry );
-      auto outlines = make_outline_buffer( geometry );
+  /* store `strings` as the end offset of every string and the characters */
+  static void flatten_strings( const std::vector<string>& strings, std::vector<uint64_t>& offsets, string& chars ) {
+    offsets.reserve( strings.size() + 1 );
+    offsets.push_back( 0 );
 
-      _buffer_offsets.push_back( std::make_pair( combined_vertices.size(), combined_outlines.size() ) );
+    for ( const auto& str : strings ) {
+      chars += str;
+      offsets.push_back( chars.size() );
+    }
+  }
 
-      /* insert the triangle and outline vertices in the combined list */
-      combined_vertices.insert( combined_vertices.end(), vertices.begin(), vertices.end() );
-      combined_outlines.insert( combined_outlines.end(), outlines.begin(), outlines.end() );
+  /* inverse of `flatten_strings`, returns false if the offsets are not valid */
+  static bool unflatten_strings( const uint64_t* offsets, size_t num_offsets, const char* chars, size_t num_chars, std::vector<string>& strings ) {
+    if ( num_offsets == 0 || offsets[0] != 0 )
+      return false;
 
-      /* store the sizes for later use */
-      _buffer_sizes.push_back( std::make_pair( vertices.size(), outlines.size() ) );
+    strings.reserve( num_offsets - 1 );
+    for ( size_t i = 1; i < num_offsets; i++ ) {
+      if ( offsets[i] < offsets[i - 1] || offsets[i] > num_chars )
+        return false;
+
+      strings.emplace_back( chars + offsets[i - 1], offsets[i] - offsets[i - 1] );
     }
 
-    /* create vertex buffers for both triangles and outlines */
-    _consolidated_vertices = new VertexBuffer<Position3, PolygonIDAttribute>( combined_vertices.size(), combined_vertices.data() );
-    _consolidated_outlines = new VertexBuffer<Position3>( combined_outlines.size(), combined_outlines.data() );
+    return true;
+  }
+
+  MapLayer::MapLayer( const string& filename ) : MapLayer( filename, nullptr ) {
+    PROFILE_FUNCTION();
+
+    /* upload everything at once */
+    upload( std::numeric_limits<size_t>::max() );
+  }
+
+  MapLayer::MapLayer( const string& filename, TaskProgress* progress ) {
+    PROFILE_FUNCTION();
+
+    /* warm start from the cache if the file has not changed since it was made */
+    if ( !load_cache( filename, progress ) && !( progress && progress->cancelled ) )
+      load_source( filename, progress );
+
+    /* a cancelled load is discarded by the caller, do not bother with the rest */
+    if ( progress && progress->cancelled )
+      return;
+
+    if ( _geometries.empty() )
+      return;
 
     /* assign the name using filename */
     _layer_name = filename;
@@ -56,6 +106,453 @@ namespace mv {
 
   MapLayer::~MapLayer( void ) {} /* do nothing */
 
+  bool MapLayer::upload( size_t budget ) {
+    PROFILE_FUNCTION();
+
+    if ( is_uploaded() )
+      return true;
+
+    /* create the buffers with the final size, they are filled in chunks */
+    if ( _vertices == nullptr ) {
+      _vertices = new VertexBuffer<GridPosition2, PolygonIDAttribute>( _num_staged_vertices, nullptr );
+      _triangles = new IndexBuffer( _num_staged_triangles, nullptr );
+      _outlines = new IndexBuffer( _num_staged_outlines, nullptr );
+
+      _vertex_blocks.reset( _num_staged_vertices );
+      reset_index_blocks();
+    }
+
+    /* the vertices go first as the indices refer to them, then the triangles */
+    /* and the outlines, at least one element is uploaded every call so that  */
+    /* a tiny budget still makes progress                                     */
+    size_t vertices = std::min( _num_staged_vertices - _uploaded_vertices, std::max<size_t>( budget / sizeof( Vertex ), 1 ) );
+    _vertices->set_range( _uploaded_vertices, vertices, _staged_vertices + _uploaded_vertices );
+    _uploaded_vertices += vertices;
+    budget -= std::min( budget, vertices * sizeof( Vertex ) );
+
+    if ( _uploaded_vertices == _num_staged_vertices ) {
+      size_t triangles = std::min( _num_staged_triangles - _uploaded_triangles, std::max<size_t>( budget / sizeof( uint32_t ), 1 ) );
+      _triangles->set_range( _uploaded_triangles, triangles, _staged_triangles + _uploaded_triangles );
+      _uploaded_triangles += triangles;
+      budget -= std::min( budget, triangles * sizeof( uint32_t ) );
+    }
+
+    if ( _uploaded_triangles == _num_staged_triangles ) {
+      size_t outlines = std::min( _num_staged_outlines - _uploaded_outlines, std::max<size_t>( budget / sizeof( uint32_t ), 1 ) );
+      _outlines->set_range( _uploaded_outlines, outlines, _staged_outlines + _uploaded_outlines );
+      _uploaded_outlines += outlines;
+    }
+
+    if ( !is_uploaded() )
+      return false;
+
+    /* everything is on the GPU, release the CPU copy */
+    _staged_vertices = nullptr;
+    _staged_triangles = nullptr;
+    _staged_outlines = nullptr;
+    _staged_vertex_storage = std::vector<Vertex>();
+    _staged_triangle_storage = std::vector<uint32_t>();
+    _staged_outline_storage = std::vector<uint32_t>();
+    _staged_cache.reset();
+
+    return true;
+  }
+
+  void MapLayer::load_source( const string& filename, TaskProgress* progress ) {
+    PROFILE_FUNCTION();
+
+    /* The features are parsed and triangulated in batches on all the threads, */
+    /* the batches come back in the order of the file and are merged here.     */
+    std::vector<LoadBatch> batches;
+    bool loaded = load_geojson_parallel<LoadBatch>( filename, batches, [&] ( std::vector<Ref<Geometry>>& geometries, AttributeTable& attributes, LoadBatch& batch ) -> void {
+      /* the context of the thread counts across batches, only this batch is kept */
+      TriangulationStats before = Triangulator::get().stats();
+
+      for ( auto& geometry : geometries ) {
+        /* The indices of every polygon, the vertices are made once the grid  */
+        /* is known from the whole layer. The indices are relative to the     */
+        /* batch, they are moved to the layer when merged.                    */
+        BufferRange range = { batch.vertices, batch.triangles.size(), batch.outlines.size(), geometry->vertices(), 0, 0 };
+        batch.vertices += geometry->vertices();
+
+        for ( uint32_t polygon = 0; polygon < geometry->polygons(); polygon++ ) {
+          size_t triangles = batch.triangles.size(), outlines = batch.outlines.size();
+
+          make_index_buffers( geometry, polygon, (uint32_t)range.vertex_offset, batch.triangles, batch.outlines );
+
+          batch.polygon_sizes.push_back( { (uint32_t)( batch.triangles.size() - triangles ), (uint32_t)( batch.outlines.size() - outlines ) } );
+        }
+
+        range.triangles = batch.triangles.size() - range.triangle_offset;
+        range.outlines = batch.outlines.size() - range.outline_offset;
+        batch.ranges.push_back( range );
+      }
+
+      const TriangulationStats& after = Triangulator::get().stats();
+      batch.triangulation.fan_rings = after.fan_rings - before.fan_rings;
+      batch.triangulation.earcut_rings = after.earcut_rings - before.earcut_rings;
+
+      batch.geometries = std::move( geometries );
+      batch.attributes = std::move( attributes );
+    }, progress );
+
+    /* return if not able to load the file */
+    if ( !loaded )
+      return;
+
+    /* combined vertices and indices for all the polygons in the file */
+    std::vector<MapLayer::Vertex> combined_vertices;
+    std::vector<uint32_t> combined_triangles, combined_outlines;
+
+    {
+      size_t num_geometries = 0, num_polygons = 0, num_vertices = 0, num_triangles = 0, num_outlines = 0;
+      for ( const auto& batch : batches ) {
+        num_geometries += batch.geometries.size();
+        num_polygons   += batch.polygon_sizes.size();
+        num_vertices   += batch.vertices;
+        num_triangles  += batch.triangles.size();
+        num_outlines   += batch.outlines.size();
+      }
+
+      _geometries.reserve( num_geometries );
+      _first_polygon.reserve( num_geometries );
+      _polygon_buffer_sizes.reserve( num_polygons );
+      _buffer_ranges.reserve( num_geometries );
+      combined_vertices.reserve( num_vertices );
+      combined_triangles.reserve( num_triangles );
+      combined_outlines.reserve( num_outlines );
+    }
+
+    uint32_t vertex_base = 0;
+    for ( auto& batch : batches ) {
+      size_t triangle_base = combined_triangles.size();
+      size_t outline_base = combined_outlines.size();
+
+      for ( size_t i = 0; i < batch.geometries.size(); i++ ) {
+        /* yes the first geometry will have id = 1, this is to */
+        /* make 0 as invalid id                                */
+        batch.geometries[i]->set_id( ++_unique_id );
+
+        BufferRange range = batch.ranges[i];
+        range.vertex_offset += vertex_base;
+        range.triangle_offset += triangle_base;
+        range.outline_offset += outline_base;
+
+        _buffer_ranges.push_back( range );
+        _first_polygon.push_back( (uint32_t)( _first_polygon.empty() ? 0 : _first_polygon.back() + _geometries.back()->polygons() ) );
+        _geometries.push_back( batch.geometries[i] );
+      }
+
+      _polygon_buffer_sizes.insert( _polygon_buffer_sizes.end(), batch.polygon_sizes.begin(), batch.polygon_sizes.end() );
+      _triangulation_stats += batch.triangulation;
+
+      /* the indices of the batch start at its first vertex in the combined list */
+      for ( auto& index : batch.triangles )
+        index += vertex_base;
+
+      for ( auto& index : batch.outlines ) {
+        if ( index != IndexBuffer::RESTART )
+          index += vertex_base;
+      }
+
+      /* insert the indices of the batch in the combined list */
+      vertex_base += (uint32_t)batch.vertices;
+      combined_triangles.insert( combined_triangles.end(), batch.triangles.begin(), batch.triangles.end() );
+      combined_outlines.insert( combined_outlines.end(), batch.outlines.begin(), batch.outlines.end() );
+
+      /* the rows of the batch follow the rows of the previous batches like the ids */
+      _attributes.append( batch.attributes );
+
+      /* release the memory of the batch as soon as it is merged */
+      batch = LoadBatch();
+    }
+
+    if ( _geometries.empty() )
+      return;
+
+    /* the geometries are drawn in the order of the leaves of the index */
+    build_index();
+    build_grid();
+    arrange( combined_vertices, combined_triangles, combined_outlines );
+
+    /* the simplified levels follow the full resolution in the index buffers */
+    build_lods( combined_triangles, combined_outlines );
+
+    /* the next launch can skip all of the above */
+    write_cache( filename, combined_vertices, combined_triangles, combined_outlines );
+
+    /* keep the vertices and indices until they are uploaded */
+    _staged_vertex_storage = std::move( combined_vertices );
+    _staged_triangle_storage = std::move( combined_triangles );
+    _staged_outline_storage = std::move( combined_outlines );
+
+    _staged_vertices = _staged_vertex_storage.data();
+    _staged_triangles = _staged_triangle_storage.data();
+    _staged_outlines = _staged_outline_storage.data();
+    _num_staged_vertices = _staged_vertex_storage.size();
+    _num_staged_triangles = _staged_triangle_storage.size();
+    _num_staged_outlines = _staged_outline_storage.size();
+  }
+
+  bool MapLayer::load_cache( const string& filename, TaskProgress* progress ) {
+    PROFILE_FUNCTION();
+
+    auto cache = std::make_unique<LayerCache>();
+    if ( !cache->open( filename ) )
+      return false;
+
+    using Section = LayerCache::Section;
+
+    size_t num_vertices, num_triangles, num_outlines, num_ranges, num_polygon_sizes, num_lod_tolerances, num_lod_ranges, num_boxes, num_geometry_polygons,
+           num_polygon_sub_polygons, num_sub_polygon_vertices, num_positions, num_name_offsets, num_name_chars, num_dictionary_sizes, num_attribute_types,
+           num_attribute_values, num_string_offsets, num_string_chars;
+
+    const Vertex*            vertices             = cache->get<Vertex>( Section::Vertices, num_vertices );
+    const uint32_t*          triangles            = cache->get<uint32_t>( Section::TriangleIndices, num_triangles );
+    const uint32_t*          outlines             = cache->get<uint32_t>( Section::OutlineIndices, num_outlines );
+    const BufferRange*       ranges               = cache->get<BufferRange>( Section::BufferRanges, num_ranges );
+    const PolygonBufferSize* polygon_sizes        = cache->get<PolygonBufferSize>( Section::PolygonBufferSizes, num_polygon_sizes );
+    const double*            lod_tolerances       = cache->get<double>( Section::LodTolerances, num_lod_tolerances );
+    const IndexRange*        lod_ranges           = cache->get<IndexRange>( Section::LodRanges, num_lod_ranges );
+    const Box*               boxes                = cache->get<Box>( Section::BoundingBoxes, num_boxes );
+    const uint32_t*          geometry_polygons    = cache->get<uint32_t>( Section::GeometryPolygons, num_geometry_polygons );
+    const uint32_t*          polygon_sub_polygons = cache->get<uint32_t>( Section::PolygonSubPolygons, num_polygon_sub_polygons );
+    const uint32_t*          sub_polygon_vertices = cache->get<uint32_t>( Section::SubPolygonVertices, num_sub_polygon_vertices );
+    const glm::dvec3*        positions            = cache->get<glm::dvec3>( Section::Positions, num_positions );
+    const uint64_t*          name_offsets         = cache->get<uint64_t>( Section::AttributeNameOffsets, num_name_offsets );
+    const char*              name_chars           = cache->get<char>( Section::AttributeNames, num_name_chars );
+    const uint64_t*          dictionary_sizes     = cache->get<uint64_t>( Section::AttributeDictionarySizes, num_dictionary_sizes );
+    const AttributeType*     attribute_types      = cache->get<AttributeType>( Section::AttributeTypes, num_attribute_types );
+    const uint64_t*          attribute_values     = cache->get<uint64_t>( Section::AttributeValues, num_attribute_values );
+    const uint64_t*          string_offsets       = cache->get<uint64_t>( Section::AttributeStringOffsets, num_string_offsets );
+    const char*              string_chars         = cache->get<char>( Section::AttributeStrings, num_string_chars );
+
+    size_t num_geometries = num_ranges;
+    if ( num_geometries == 0 || num_boxes != num_geometries || num_geometry_polygons != num_geometries ||
+         num_polygon_sizes != num_polygon_sub_polygons || num_lod_tolerances != LOD_LEVELS || num_lod_ranges != LOD_LEVELS * num_geometries ) {
+      LOG_WARN( "layer cache for `{}` is corrupted; ignoring", filename );
+      return false;
+    }
+
+    /* Rebuild the geometries from the flattened arrays. Every count is checked */
+    /* against the size of the array it indexes so that a damaged cache cannot  */
+    /* read out of the mapping, the source is loaded instead.                   */
+    auto load = [&] () -> bool {
+      size_t polygon = 0, sub_polygon = 0, position = 0;
+
+      _geometries.reserve( num_geometries );
+      _buffer_ranges.assign( ranges, ranges + num_ranges );
+      _first_polygon.reserve( num_geometries );
+      _polygon_buffer_sizes.assign( polygon_sizes, polygon_sizes + num_polygon_sizes );
+      _lod_tolerances.assign( lod_tolerances, lod_tolerances + num_lod_tolerances );
+      _lod_ranges.assign( lod_ranges, lod_ranges + num_lod_ranges );
+
+      for ( size_t g = 0; g < num_geometries; g++ ) {
+        if ( progress && progress->cancelled )
+          return false;
+
+        Ref<Geometry> geometry = new Geometry();
+        uint64_t geometry_triangles = 0, geometry_outlines = 0;
+
+        _first_polygon.push_back( (uint32_t)polygon );
+
+        for ( uint32_t p = 0; p < geometry_polygons[g]; p++, polygon++ ) {
+          if ( polygon >= num_polygon_sub_polygons )
+            return false;
+
+          geometry_triangles += polygon_sizes[polygon].triangles;
+          geometry_outlines += polygon_sizes[polygon].outlines;
+
+          for ( uint32_t s = 0; s < polygon_sub_polygons[polygon]; s++, sub_polygon++ ) {
+            if ( sub_polygon >= num_sub_polygon_vertices || sub_polygon_vertices[sub_polygon] > num_positions - position )
+              return false;
+
+            geometry->push_sub_polygon( positions + position, sub_polygon_vertices[sub_polygon] );
+            position += sub_polygon_vertices[sub_polygon];
+          }
+
+          geometry->end_polygon();
+        }
+
+        const BufferRange& range = ranges[g];
+        if ( !in_bounds( range.vertex_offset, range.vertices, num_vertices ) )
+          return false;
+
+        /* the polygons must cover the range of the geometry exactly */
+        if ( range.vertices != geometry->vertices() || geometry_triangles != range.triangles || geometry_outlines != range.outlines ||
+             geometry->polygons() != geometry_polygons[g] )
+          return false;
+
+        geometry->set_bbox( boxes[g] );
+        geometry->set_id( ++_unique_id );
+
+        _geometries.push_back( geometry );
+      }
+
+      /* the index and the grid are cheaper to build again than to store */
+      build_index();
+      build_grid();
+
+      /* the ranges of all the levels must cover the indices one after the */
+      /* other, the geometries of every level in the order of the index    */
+      uint64_t triangle_offset = 0, outline_offset = 0;
+      auto follows = [&] ( const auto& range ) -> bool {
+        if ( range.triangle_offset != triangle_offset || !in_bounds( range.triangle_offset, range.triangles, num_triangles ) ||
+             range.outline_offset != outline_offset || !in_bounds( range.outline_offset, range.outlines, num_outlines ) )
+          return false;
+
+        triangle_offset += range.triangles;
+        outline_offset += range.outlines;
+        return true;
+      };
+
+      for ( uint32_t level = 0; level <= LOD_LEVELS; level++ ) {
+        for ( uint32_t leaf = 0; leaf < num_geometries; leaf++ ) {
+          uint32_t g = _index.item( leaf );
+          if ( !( level == 0 ? follows( ranges[g] ) : follows( lod_ranges[( level - 1 ) * num_geometries + g] ) ) )
+            return false;
+        }
+      }
+
+      if ( triangle_offset != num_triangles || outline_offset != num_outlines )
+        return false;
+
+      /* the indices go to the GPU as they are, they must not read past the vertices */
+      for ( size_t i = 0; i < num_triangles; i++ ) {
+        if ( triangles[i] >= num_vertices )
+          return false;
+      }
+
+      for ( size_t i = 0; i < num_outlines; i++ ) {
+        if ( outlines[i] >= num_vertices && outlines[i] != IndexBuffer::RESTART )
+          return false;
+      }
+
+      /* the attributes are stored column after column */
+      std::vector<string> names, strings;
+      if ( !unflatten_strings( name_offsets, num_name_offsets, name_chars, num_name_chars, names ) ||
+           !unflatten_strings( string_offsets, num_string_offsets, string_chars, num_string_chars, strings ) )
+        return false;
+
+      size_t num_cells = names.size() * num_geometries;
+      if ( num_dictionary_sizes != names.size() || num_attribute_types != num_cells || num_attribute_values != num_cells )
+        return false;
+
+      return _attributes.assign( names, dictionary_sizes, num_geometries, attribute_types, attribute_values, std::move( strings ) );
+    };
+
+    if ( !load() ) {
+      if ( !( progress && progress->cancelled ) )
+        LOG_WARN( "layer cache for `{}` is corrupted; ignoring", filename );
+
+      _geometries.clear();
+      _buffer_ranges.clear();
+      _first_polygon.clear();
+      _polygon_buffer_sizes.clear();
+      _lod_tolerances.clear();
+      _lod_ranges.clear();
+      _index.clear();
+      _bounding_box = Box();
+      _attributes.clear();
+      _unique_id = 0;
+      return false;
+    }
+
+    /* the vertices and indices are uploaded straight from the mapped cache */
+    _staged_vertices = vertices;
+    _staged_triangles = triangles;
+    _staged_outlines = outlines;
+    _num_staged_vertices = num_vertices;
+    _num_staged_triangles = num_triangles;
+    _num_staged_outlines = num_outlines;
+    _staged_cache = std::move( cache );
+
+    return true;
+  }
+
+  void MapLayer::write_cache( const string& filename, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& outlines ) const {
+    PROFILE_FUNCTION();
+
+    /* flatten the geometries in arrays */
+    std::vector<Box>        boxes;
+    std::vector<uint32_t>   geometry_polygons, polygon_sub_polygons, sub_polygon_vertices;
+    std::vector<glm::dvec3> positions;
+
+    boxes.reserve( _geometries.size() );
+    geometry_polygons.reserve( _geometries.size() );
+
+    for ( size_t g = 0; g < _geometries.size(); g++ ) {
+      const Ref<Geometry>& geometry = _geometries[g];
+
+      boxes.push_back( geometry->bbox() );
+
+      for ( const auto& polygon : *geometry ) {
+        for ( const auto& sub_polygon : polygon ) {
+          sub_polygon_vertices.push_back( sub_polygon.vertices() );
+          positions.insert( positions.end(), sub_polygon.begin(), sub_polygon.end() );
+        }
+
+        polygon_sub_polygons.push_back( polygon.sub_polygons() );
+      }
+
+      geometry_polygons.push_back( geometry->polygons() );
+    }
+
+    /* the columns of the attributes one after the other, the strings  */
+    /* are the pool followed by the dictionary of every column         */
+    std::vector<string>        names, strings;
+    std::vector<AttributeType> attribute_types;
+    std::vector<uint64_t>      attribute_values, dictionary_sizes, name_offsets, string_offsets;
+    string                     name_chars, string_chars;
+
+    strings.reserve( _attributes.pool_size() );
+    for ( size_t i = 0; i < _attributes.pool_size(); i++ )
+      strings.emplace_back( _attributes.pool_string( i ) );
+
+    attribute_types.reserve( _attributes.columns() * _attributes.rows() );
+    attribute_values.reserve( _attributes.columns() * _attributes.rows() );
+
+    for ( uint32_t c = 0; c < _attributes.columns(); c++ ) {
+      names.push_back( _attributes.column_name( c ) );
+      attribute_types.insert( attribute_types.end(), _attributes.column_types( c ).begin(), _attributes.column_types( c ).end() );
+      attribute_values.insert( attribute_values.end(), _attributes.column_values( c ).begin(), _attributes.column_values( c ).end() );
+
+      size_t dictionary_size = _attributes.is_dictionary( c ) ? _attributes.dictionary_size( c ) : 0;
+      for ( uint32_t code = 0; code < dictionary_size; code++ )
+        strings.push_back( _attributes.dictionary_value( c, code ) );
+      dictionary_sizes.push_back( dictionary_size );
+    }
+
+    flatten_strings( names, name_offsets, name_chars );
+    flatten_strings( strings, string_offsets, string_chars );
+
+    using Section = LayerCache::Section;
+
+    LayerCache cache;
+    cache.set( Section::Vertices, vertices.data(), vertices.size() );
+    cache.set( Section::TriangleIndices, triangles.data(), triangles.size() );
+    cache.set( Section::OutlineIndices, outlines.data(), outlines.size() );
+    cache.set( Section::BufferRanges, _buffer_ranges.data(), _buffer_ranges.size() );
+    cache.set( Section::PolygonBufferSizes, _polygon_buffer_sizes.data(), _polygon_buffer_sizes.size() );
+    cache.set( Section::LodTolerances, _lod_tolerances.data(), _lod_tolerances.size() );
+    cache.set( Section::LodRanges, _lod_ranges.data(), _lod_ranges.size() );
+    cache.set( Section::BoundingBoxes, boxes.data(), boxes.size() );
+    cache.set( Section::GeometryPolygons, geometry_polygons.data(), geometry_polygons.size() );
+    cache.set( Section::PolygonSubPolygons, polygon_sub_polygons.data(), polygon_sub_polygons.size() );
+    cache.set( Section::SubPolygonVertices, sub_polygon_vertices.data(), sub_polygon_vertices.size() );
+    cache.set( Section::Positions, positions.data(), positions.size() );
+    cache.set( Section::AttributeNameOffsets, name_offsets.data(), name_offsets.size() );
+    cache.set( Section::AttributeNames, name_chars.data(), name_chars.size() );
+    cache.set( Section::AttributeDictionarySizes, dictionary_sizes.data(), dictionary_sizes.size() );
+    cache.set( Section::AttributeTypes, attribute_types.data(), attribute_types.size() );
+    cache.set( Section::AttributeValues, attribute_values.data(), attribute_values.size() );
+    cache.set( Section::AttributeStringOffsets, string_offsets.data(), string_offsets.size() );
+    cache.set( Section::AttributeStrings, string_chars.data(), string_chars.size() );
+
+    /* not having a cache only makes the next load slower */
+    cache.write( filename );
+  }
+
   void MapLayer::select( polygon_id id ) {
     PROFILE_FUNCTION();
 
@@ -125,153 +622,713 @@ namespace mv {
     return _geometries[id - 1];
   }
 
-  Box MapLayer::bounding_box( void ) const {
+  std::vector<polygon_id> MapLayer::query( const Box& box ) const {
     PROFILE_FUNCTION();
 
-    Box bb;
+    std::vector<uint32_t> items;
+    _index.query( box, items );
 
-    /* compute the comnbined bounding box */
-    for ( const auto& geom : _geometries )
-      bb.unify( geom->bbox() );
+    /* the items are the geometries in the order of the ids */
+    for ( auto& item : items )
+      item++;
 
-    return bb;
+    return items;
+  }
+
+  std::vector<polygon_id> MapLayer::query( const glm::dvec2& point ) const {
+    PROFILE_FUNCTION();
+
+    std::vector<uint32_t> items;
+    _index.query( point, items );
+
+    for ( auto& item : items )
+      item++;
+
+    return items;
+  }
+
+  std::vector<polygon_id> MapLayer::pick( const glm::dvec2& point, double tolerance ) const {
+    PROFILE_FUNCTION();
+
+    /* only the geometries whose box is within the tolerance can be under the point */
+    Box box;
+    box.include( glm::dvec3( point - tolerance, 0.0 ) );
+    box.include( glm::dvec3( point + tolerance, 0.0 ) );
+
+    std::vector<uint32_t> items;
+    _index.query( box, items );
+
+    std::vector<polygon_id> ids;
+    for ( uint32_t item : items ) {
+      const Ref<Geometry>& geometry = _geometries[item];
+
+      if ( ( _draw_triangles && geometry->contains( point ) ) || geometry->outline_distance2( point ) <= tolerance * tolerance )
+        ids.push_back( geometry->id() );
+    }
+
+    return ids;
   }
 
   void MapLayer::update( polygon_id id ) {
     PROFILE_FUNCTION();
 
+    /* the buffers are edited in place, the upload must be complete */
+    upload( std::numeric_limits<size_t>::max() );
+
     /* find geometry with `id` */
     Ref<Geometry> geom = get_geometry( id );
     if ( geom == nullptr )
       return;
 
-    /* compute triangulated vertices and outlines */
-    std::vector<MapLayer::Vertex> vertices = make_polygon_buffer( geom );
-    std::vector<glm::vec3> outlines = make_outline_buffer( geom );
+    /* only the edited polygons are triangulated again */
+    if ( !geom->is_dirty() )
+      return;
+
+    BufferRange& range = _buffer_ranges[id - 1];
+
+    /* the chunk of the geometry is drawn geometry by geometry if it moved */
+    uint32_t chunk = _index.leaf( id - 1 ) / chunk_size();
+
+    /* The vertices are written over when their number did not change, */
+    /* otherwise every index of the geometry changes and all of its    */
+    /* polygons are built again.                                       */
+    std::vector<MapLayer::Vertex> vertices;
+    make_vertex_buffer( geom, vertices );
+
+    bool rebuild = vertices.size() != range.vertices;
+    write_block( *_vertices, _vertex_blocks, range.vertex_offset, range.vertices, vertices.size(), vertices.data() );
+
+    std::vector<uint32_t> triangles, outlines;
+    uint32_t first_polygon = _first_polygon[id - 1];
+    uint32_t base_vertex = (uint32_t)range.vertex_offset;
+
+    /* the edited polygons are built first, they are written in */
+    /* place if none of them changed its number of indices      */
+    const auto& dirty = geom->dirty_polygons();
 
-    /* compute the offset where the vertices and outlines for */
-    /* this geometry is located at                            */
-    size_t polygon_offset = _buffer_offsets[id - 1].first;
-    size_t outline_offset = _buffer_offsets[id - 1].second;
+    for ( size_t i = 0; i < dirty.size() && !rebuild; i++ ) {
+      size_t first_triangle = triangles.size(), first_outline = outlines.size();
+      make_index_buffers( geom, dirty[i], base_vertex, triangles, outlines );
 
-    /* replace the memory with the new triangles and outlines */
-    _consolidated_vertices->replace( polygon_offset, _buffer_sizes[id - 1].first, vertices.size(), vertices.data() );
-    _consolidated_outlines->replace( outline_offset, _buffer_sizes[id - 1].second, outlines.size(), outlines.data() );
+      const PolygonBufferSize& size = _polygon_buffer_sizes[first_polygon + dirty[i]];
+      rebuild = triangles.size() - first_triangle != size.triangles || outlines.size() - first_outline != size.outlines;
+    }
+
+    bool moved = false;
+
+    if ( !rebuild ) {
+      size_t triangle_offset = range.triangle_offset, outline_offset = range.outline_offset;
+      size_t built_triangles = 0, built_outlines = 0;
+      auto next_dirty = dirty.begin();
+
+      /* the polygons are one after the other, the ones before an edited */
+      /* polygon are skipped using their sizes                           */
+      for ( uint32_t polygon = 0; polygon < geom->polygons() && next_dirty != dirty.end(); polygon++ ) {
+        const PolygonBufferSize& size = _polygon_buffer_sizes[first_polygon + polygon];
+
+        if ( *next_dirty == polygon ) {
+          _triangles->set_range( triangle_offset, size.triangles, triangles.data() + built_triangles );
+          _outlines->set_range( outline_offset, size.outlines, outlines.data() + built_outlines );
 
-    /* update the sizes */
-    _buffer_sizes[id - 1] = std::make_pair( vertices.size(), outlines.size() );
+          built_triangles += size.triangles;
+          built_outlines += size.outlines;
+          ++next_dirty;
+        }
+
+        triangle_offset += size.triangles;
+        outline_offset += size.outlines;
+      }
+    } else {
+      triangles.clear();
+      outlines.clear();
 
-    /* update the offsets */
-    for ( polygon_id i = id - 1; i < _buffer_offsets.size(); i++ ) {
-      _buffer_offsets[i] = std::make_pair( polygon_offset, outline_offset );
+      for ( uint32_t polygon = 0; polygon < geom->polygons(); polygon++ ) {
+        size_t first_triangle = triangles.size(), first_outline = outlines.size();
+        make_index_buffers( geom, polygon, base_vertex, triangles, outlines );
+
+        _polygon_buffer_sizes[first_polygon + polygon] = { (uint32_t)( triangles.size() - first_triangle ), (uint32_t)( outlines.size() - first_outline ) };
+      }
 
-      polygon_offset += _buffer_sizes[i].first;
-      outline_offset += _buffer_sizes[i].second;
+      /* the geometry is written as a whole to its block */
+      moved |= write_block( *_triangles, _triangle_blocks, range.triangle_offset, range.triangles, triangles.size(), triangles.data() );
+      moved |= write_block( *_outlines, _outline_blocks, range.outline_offset, range.outlines, outlines.size(), outlines.data() );
     }
+
+    if ( moved )
+      _moved_chunks[chunk] = 1;
+
+    geom->clear_dirty();
+
+    /* the geometry may have moved out of its box */
+    Box old_box = geom->bbox();
+    geom->compute_bbox();
+    _index.update( id - 1, geom->bbox() );
+    update_extent( old_box, geom->bbox() );
+
+    /* Simplifying every level takes much longer than the edit itself, the */
+    /* levels are built when one of them is drawn next. An edit is mostly  */
+    /* done at the full resolution, where they are not needed.             */
+    if ( !_lod_tolerances.empty() && std::find( _stale_lods.begin(), _stale_lods.end(), id ) == _stale_lods.end() )
+      _stale_lods.push_back( id );
+
+    finish_edit();
+  }
+
+  void MapLayer::update_lods( void ) {
+    PROFILE_FUNCTION();
+
+    if ( _stale_lods.empty() )
+      return;
+
+    uint32_t chunks = ( (uint32_t)_geometries.size() + chunk_size() - 1 ) / chunk_size();
+
+    for ( polygon_id id : _stale_lods ) {
+      Ref<Geometry> geom = get_geometry( id );
+      if ( geom == nullptr )
+        continue;
+
+      uint32_t chunk = _index.leaf( id - 1 ) / chunk_size();
+
+      /* the simplified levels of the geometry are built again as a whole */
+      LodBuffers lods;
+      make_lod_buffers( geom, (uint32_t)_buffer_ranges[id - 1].vertex_offset, lods );
+
+      for ( uint32_t level = 0; level < LOD_LEVELS; level++ ) {
+        IndexRange& lod = _lod_ranges[level * _geometries.size() + id - 1];
+        const IndexRange& built = lods.ranges[level].front();
+
+        bool moved = write_block( *_triangles, _triangle_blocks, lod.triangle_offset, lod.triangles, built.triangles, lods.triangles[level].data() );
+        moved |= write_block( *_outlines, _outline_blocks, lod.outline_offset, lod.outlines, built.outlines, lods.outlines[level].data() );
+
+        if ( moved )
+          _moved_chunks[( level + 1 ) * chunks + chunk] = 1;
+      }
+    }
+
+    _stale_lods.clear();
+    finish_edit();
+  }
+
+  void MapLayer::finish_edit( void ) {
+    /* the free blocks are dropped once they take too much of the buffers */
+    if ( _triangle_blocks.free_size() > _triangle_blocks.size() * COMPACT_FREE_FRACTION ||
+         _outline_blocks.free_size() > _outline_blocks.size() * COMPACT_FREE_FRACTION ) {
+      compact();
+    }
+
+    /* everything is still on the GPU with the new sizes */
+    _num_staged_vertices = _uploaded_vertices = _vertices->array_size();
+    _num_staged_triangles = _uploaded_triangles = _triangles->indices();
+    _num_staged_outlines = _uploaded_outlines = _outlines->indices();
+  }
+
+  void MapLayer::compact( void ) {
+    PROFILE_FUNCTION();
+
+    /* the indices are copied on the GPU, the upload must be complete */
+    upload( std::numeric_limits<size_t>::max() );
+
+    if ( _geometries.empty() )
+      return;
+
+    std::vector<BufferRange> old_ranges = _buffer_ranges;
+    std::vector<IndexRange> old_lod_ranges = _lod_ranges;
+    layout_ranges();
+
+    /* the copies follow the new layout so that the ones of a chunk */
+    /* which did not move are merged into one                       */
+    std::vector<BufferCopy> triangle_copies, outline_copies;
+    triangle_copies.reserve( _geometries.size() * lod_levels() );
+    outline_copies.reserve( _geometries.size() * lod_levels() );
+
+    auto copy = [&] ( const auto& from, const auto& to ) -> void {
+      if ( to.triangles > 0 )
+        triangle_copies.push_back( { from.triangle_offset, to.triangle_offset, to.triangles } );
+      if ( to.outlines > 0 )
+        outline_copies.push_back( { from.outline_offset, to.outline_offset, to.outlines } );
+    };
+
+    for ( uint32_t leaf = 0; leaf < _geometries.size(); leaf++ ) {
+      uint32_t g = _index.item( leaf );
+      copy( old_ranges[g], _buffer_ranges[g] );
+    }
+
+    for ( uint32_t level = 0; level < _lod_tolerances.size(); level++ ) {
+      for ( uint32_t leaf = 0; leaf < _geometries.size(); leaf++ ) {
+        size_t lod = level * _geometries.size() + _index.item( leaf );
+        copy( old_lod_ranges[lod], _lod_ranges[lod] );
+      }
+    }
+
+    _triangles->gather( _triangle_blocks.size() - _triangle_blocks.free_size(), triangle_copies );
+    _outlines->gather( _outline_blocks.size() - _outline_blocks.free_size(), outline_copies );
+
+    _num_staged_triangles = _uploaded_triangles = _triangles->indices();
+    _num_staged_outlines = _uploaded_outlines = _outlines->indices();
+
+    reset_index_blocks();
   }
 
   std::tuple<uint32_t, uint32_t> MapLayer::get_outline_indices( polygon_id id ) const {
     PROFILE_FUNCTION();
 
-    /* return 0 if the id is not present in the layer */
+    /* return 0 if the id is not present in the layer or not uploaded yet */
     if ( !has( id ) ) return { 0, 0 };
 
-    return { _buffer_offsets[id - 1].second, _buffer_sizes[id - 1].second };
+    const BufferRange& range = _buffer_ranges[id - 1];
+    if ( _uploaded_vertices != _num_staged_vertices || range.outline_offset + range.outlines > _uploaded_outlines ) return { 0, 0 };
+
+    return { (uint32_t)range.outline_offset, (uint32_t)range.outlines };
   }
 
-  std::vector<MapLayer::Vertex> MapLayer::make_polygon_buffer( Ref<Geometry> geometry ) {
+  uint32_t MapLayer::lod_level( double world_per_pixel ) const {
+    double tolerance = world_per_pixel * LOD_PIXEL_TOLERANCE;
 
-    /* triangulated coordinates */
-    std::vector<MapLayer::Vertex> vertices;
+    /* the tolerances grow with the level */
+    uint32_t level = 0;
+    while ( level < _lod_tolerances.size() && _lod_tolerances[level] <= tolerance )
+      level++;
 
-    polygon_id id = geometry->id();
+    return level;
+  }
 
-    /* triangulate the geometry */
-    std::vector<vertex_index> indices = triangulate( geometry );
+  std::tuple<size_t, size_t> MapLayer::drawable_triangles( uint32_t level ) const {
+    if ( _uploaded_vertices != _num_staged_vertices )
+      return { 0, 0 };
 
-    /* improve performance */
-    vertices.reserve( indices.size() );
+    IndexRange range = level_range( level );
+    if ( range.triangle_offset + range.triangles <= _uploaded_triangles )
+      return { range.triangle_offset, range.triangles };
+
+    /* the full resolution is uploaded first, draw as much of it as is there */
+    size_t triangles = std::min<size_t>( _uploaded_triangles, level_range( 0 ).triangles );
+    return { 0, triangles - triangles % 3 };
+  }
+
+  std::tuple<size_t, size_t> MapLayer::drawable_outlines( uint32_t level ) const {
+    if ( _uploaded_vertices != _num_staged_vertices )
+      return { 0, 0 };
+
+    IndexRange range = level_range( level );
+    if ( range.outline_offset + range.outlines <= _uploaded_outlines )
+      return { range.outline_offset, range.outlines };
 
-    /* simply push the vertices at index */
-    for ( const auto& index : indices ) {
-      vertices.push_back( MapLayer::Vertex{ geometry->get_position( index ), { id, 0 } } );
+    return { 0, std::min<size_t>( _uploaded_outlines, level_range( 0 ).outlines ) };
+  }
+
+  MapLayer::IndexRange MapLayer::level_range( uint32_t level ) const {
+    if ( _geometries.empty() || level >= lod_levels() )
+      return { 0, 0, 0, 0 };
+
+    /* the ranges of a level are one after the other in the order of the index */
+    IndexRange first = geometry_range( level, _index.item( 0 ) );
+    IndexRange last = geometry_range( level, _index.item( (uint32_t)_geometries.size() - 1 ) );
+
+    return { first.triangle_offset, first.outline_offset, last.triangle_offset + last.triangles - first.triangle_offset,
+             last.outline_offset + last.outlines - first.outline_offset };
+  }
+
+  MapLayer::IndexRange MapLayer::geometry_range( uint32_t level, uint32_t geometry ) const {
+    if ( level == 0 ) {
+      const BufferRange& range = _buffer_ranges[geometry];
+      return { range.triangle_offset, range.outline_offset, range.triangles, range.outlines };
     }
 
-    /* return the vertices */
-    return vertices;
+    return _lod_ranges[( level - 1 ) * _geometries.size() + geometry];
   }
 
-  std::vector<glm::vec3> MapLayer::make_outline_buffer( Ref<Geometry> geometry ) {
+  void MapLayer::visible_ranges( uint32_t level, const Box& view, DrawRanges& triangles, DrawRanges& outlines ) const {
+    PROFILE_FUNCTION();
 
-    /* connected outlines */
-    std::vector<glm::vec3> outlines;
+    triangles.clear();
+    outlines.clear();
 
-    /* simply connect the vertices to create outline */
-    for ( const auto& polygon : *geometry ) {
-      for ( const auto& sub_polygon : polygon ) {
-        for ( size_t i = 0; i < sub_polygon.vertices(); i++ ) {
-          outlines.push_back( sub_polygon.get_position( i ) );
-
-          /* the last vertex will connect with the first */
-          if ( i < sub_polygon.vertices() - 1 )
-            outlines.push_back( sub_polygon.get_position( i + 1 ) );
-          else
-            outlines.push_back( sub_polygon.get_position( 0 ) );
+    /* nothing is on the GPU yet */
+    if ( _vertices == nullptr )
+      return;
+
+    /* while the level is uploading what is there is drawn as a whole, */
+    /* nothing is edited before the upload is complete                 */
+    if ( !is_uploaded() ) {
+      auto [triangle_offset, num_triangles] = drawable_triangles( level );
+      auto [outline_offset, num_outlines] = drawable_outlines( level );
+
+      IndexRange range = level_range( level );
+      if ( num_triangles != range.triangles || num_outlines != range.outlines ) {
+        if ( num_triangles > 0 )
+          triangles.add( (uint32_t)triangle_offset, (uint32_t)num_triangles );
+        if ( num_outlines > 0 )
+          outlines.add( (uint32_t)outline_offset, (uint32_t)num_outlines );
+        return;
+      }
+    }
+
+    /* a range which follows the last one is merged into it */
+    auto add = [] ( DrawRanges& ranges, uint64_t offset, uint64_t count ) -> void {
+      if ( count == 0 )
+        return;
+
+      if ( !ranges.offsets.empty() && ranges.offsets.back() + ranges.counts.back() == offset )
+        ranges.counts.back() += (uint32_t)count;
+      else
+        ranges.add( (uint32_t)offset, (uint32_t)count );
+    };
+
+    /* the geometries of a node of the index are one range in every level, */
+    /* the nodes come in order so that neighbours are drawn as one range   */
+    _index.query_nodes( view, CHUNK_LEVEL, _visible_chunks );
+
+    uint32_t geometries = (uint32_t)_geometries.size();
+    uint32_t size = chunk_size();
+    uint32_t chunks = ( geometries + size - 1 ) / size;
+
+    for ( uint32_t chunk : _visible_chunks ) {
+      uint32_t first_leaf = chunk * size;
+      uint32_t last_leaf = std::min( first_leaf + size, geometries ) - 1;
+
+      if ( !_moved_chunks[level * chunks + chunk] ) {
+        IndexRange first = geometry_range( level, _index.item( first_leaf ) );
+        IndexRange last = geometry_range( level, _index.item( last_leaf ) );
+
+        add( triangles, first.triangle_offset, last.triangle_offset + last.triangles - first.triangle_offset );
+        add( outlines, first.outline_offset, last.outline_offset + last.outlines - first.outline_offset );
+        continue;
+      }
+
+      /* the geometries of an edited chunk are anywhere in the buffers */
+      for ( uint32_t leaf = first_leaf; leaf <= last_leaf; leaf++ ) {
+        IndexRange range = geometry_range( level, _index.item( leaf ) );
+
+        add( triangles, range.triangle_offset, range.triangles );
+        add( outlines, range.outline_offset, range.outlines );
+      }
+    }
+
+    _visible_chunks.clear();
+  }
+
+  void MapLayer::layout_ranges( void ) {
+    uint64_t triangle_offset = 0, outline_offset = 0;
+
+    auto place = [&] ( auto& range ) -> void {
+      range.triangle_offset = triangle_offset;
+      range.outline_offset = outline_offset;
+
+      triangle_offset += range.triangles;
+      outline_offset += range.outlines;
+    };
+
+    /* the full resolution first, then the simplified levels, the  */
+    /* geometries of every level in the order of the index         */
+    for ( uint32_t leaf = 0; leaf < _geometries.size(); leaf++ )
+      place( _buffer_ranges[_index.item( leaf )] );
+
+    for ( uint32_t level = 0; level < _lod_tolerances.size(); level++ ) {
+      for ( uint32_t leaf = 0; leaf < _geometries.size(); leaf++ )
+        place( _lod_ranges[level * _geometries.size() + _index.item( leaf )] );
+    }
+  }
+
+  void MapLayer::reset_index_blocks( void ) {
+    _triangle_blocks.reset( _num_staged_triangles );
+    _outline_blocks.reset( _num_staged_outlines );
+
+    uint32_t chunks = ( (uint32_t)_geometries.size() + chunk_size() - 1 ) / chunk_size();
+    _moved_chunks.assign( (size_t)lod_levels() * chunks, 0 );
+  }
+
+  uint32_t MapLayer::chunk_size( void ) const {
+    uint32_t size = 1;
+    for ( uint32_t node_level = 0; node_level < CHUNK_LEVEL && node_level + 1 < _index.levels(); node_level++ )
+      size *= PackedRTree::NODE_SIZE;
+
+    return size;
+  }
+
+  void MapLayer::build_index( void ) {
+    PROFILE_FUNCTION();
+
+    std::vector<Box> boxes;
+    boxes.reserve( _geometries.size() );
+
+    /* the extent of the layer is made of the same boxes */
+    _bounding_box = Box();
+    for ( const auto& geometry : _geometries ) {
+      boxes.push_back( geometry->bbox() );
+      _bounding_box.unify( geometry->bbox() );
+    }
+
+    _index.build( boxes );
+  }
+
+  void MapLayer::update_extent( const Box& old_box, const Box& new_box ) {
+    /* the extent only shrinks where the geometry was on its edge and */
+    /* moved away from it, otherwise it grows to the new box at most  */
+    bool shrinks = false;
+    for ( int axis = 0; axis < 3; axis++ ) {
+      shrinks |= old_box.min[axis] <= _bounding_box.min[axis] && new_box.min[axis] > old_box.min[axis];
+      shrinks |= old_box.max[axis] >= _bounding_box.max[axis] && new_box.max[axis] < old_box.max[axis];
+    }
+
+    if ( !shrinks ) {
+      _bounding_box.unify( new_box );
+      return;
+    }
+
+    _bounding_box = Box();
+    for ( const auto& geometry : _geometries )
+      _bounding_box.unify( geometry->bbox() );
+  }
+
+  void MapLayer::build_grid( void ) {
+    glm::dvec3 size = _bounding_box.size();
+    double side = std::max( { size.x, size.y, std::numeric_limits<double>::min() } );
+
+    /* a power of two keeps the cells exact in float on the GPU */
+    _grid_origin = glm::dvec2( _bounding_box.center() );
+    _grid_step = std::exp2( std::ceil( std::log2( 4.0 * side / GRID_CELLS ) ) );
+  }
+
+  glm::ivec2 MapLayer::grid_cell( const glm::dvec3& position ) const {
+    glm::dvec2 cell = glm::round( ( glm::dvec2( position ) - _grid_origin ) / _grid_step );
+    return glm::ivec2( glm::clamp( cell, glm::dvec2( -GRID_LIMIT ), glm::dvec2( GRID_LIMIT ) ) );
+  }
+
+  void MapLayer::to_grid( const glm::dvec3& position, glm::ivec2& cell, glm::vec2& offset ) const {
+    /* The cell is kept one cell within the limit of the vertices so that  */
+    /* the difference with the cell of any vertex, at most 2^31 - 1, fits  */
+    /* in an int. The offset makes up for the rest.                        */
+    glm::dvec2 exact = ( glm::dvec2( position ) - _grid_origin ) / _grid_step;
+    glm::dvec2 middle = glm::clamp( glm::round( exact ), glm::dvec2( 1.0 - GRID_LIMIT ), glm::dvec2( GRID_LIMIT - 1.0 ) );
+
+    cell = glm::ivec2( middle );
+    offset = glm::vec2( exact - middle );
+  }
+
+  Ref<UniformBuffer<LayerUniforms>> MapLayer::update_uniforms( const glm::dvec3& eye ) {
+    PROFILE_FUNCTION();
+
+    LayerUniforms uniforms;
+    to_grid( eye, uniforms.eye_cell, uniforms.eye_offset );
+    uniforms.fill_color = _fill_color;
+    uniforms.line_color = _line_color;
+    uniforms.grid_step = (float)_grid_step;
+
+    if ( _uniforms )
+      _uniforms->set( uniforms );
+    else
+      _uniforms = new UniformBuffer<LayerUniforms>( uniforms );
+
+    return _uniforms;
+  }
+
+  void MapLayer::arrange( std::vector<Vertex>& vertices, std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines ) {
+    PROFILE_FUNCTION();
+
+    std::vector<uint32_t> arranged_triangles, arranged_outlines;
+
+    arranged_triangles.reserve( triangles.size() );
+    arranged_outlines.reserve( outlines.size() );
+
+    /* the vertices of every geometry are made one after the other, its */
+    /* indices move with the first vertex of the geometry               */
+    for ( uint32_t leaf = 0; leaf < _geometries.size(); leaf++ ) {
+      BufferRange& range = _buffer_ranges[_index.item( leaf )];
+      uint32_t vertex_offset = (uint32_t)vertices.size();
+
+      make_vertex_buffer( _geometries[_index.item( leaf )], vertices );
+
+      for ( size_t i = range.triangle_offset; i < range.triangle_offset + range.triangles; i++ )
+        arranged_triangles.push_back( triangles[i] - (uint32_t)range.vertex_offset + vertex_offset );
+
+      for ( size_t i = range.outline_offset; i < range.outline_offset + range.outlines; i++ )
+        arranged_outlines.push_back( outlines[i] == IndexBuffer::RESTART ? IndexBuffer::RESTART : outlines[i] - (uint32_t)range.vertex_offset + vertex_offset );
+
+      range.vertex_offset = vertex_offset;
+      range.triangle_offset = arranged_triangles.size() - range.triangles;
+      range.outline_offset = arranged_outlines.size() - range.outlines;
+    }
+
+    triangles = std::move( arranged_triangles );
+    outlines = std::move( arranged_outlines );
+  }
+
+  void MapLayer::build_lods( std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines ) {
+    PROFILE_FUNCTION();
+
+    /* the errors follow the size of the layer so that a level is */
+    /* picked from the size of a pixel at any scale of the data   */
+    glm::dvec3 size = bounding_box().size();
+    double tolerance = std::max( size.x, size.y ) * LOD_FIRST_TOLERANCE;
+
+    _lod_tolerances.clear();
+    for ( uint32_t level = 0; level < LOD_LEVELS; level++, tolerance *= LOD_LEVEL_FACTOR )
+      _lod_tolerances.push_back( tolerance );
+
+    /* the geometries are simplified in chunks on all the threads */
+    size_t num_chunks = ( _geometries.size() + LOD_CHUNK_GEOMETRIES - 1 ) / LOD_CHUNK_GEOMETRIES;
+    std::vector<LodBuffers> chunks( num_chunks );
+
+    /* the chunks follow the leaves of the index like the full resolution */
+    auto build_chunk = [&] ( size_t chunk ) -> void {
+      size_t last = std::min( ( chunk + 1 ) * LOD_CHUNK_GEOMETRIES, _geometries.size() );
+      for ( size_t leaf = chunk * LOD_CHUNK_GEOMETRIES; leaf < last; leaf++ ) {
+        uint32_t g = _index.item( (uint32_t)leaf );
+        make_lod_buffers( _geometries[g], (uint32_t)_buffer_ranges[g].vertex_offset, chunks[chunk] );
+      }
+    };
+
+    if ( ThreadPool* pool = ThreadPool::get() )
+      pool->parallel_for( num_chunks, build_chunk );
+    else
+      for ( size_t i = 0; i < num_chunks; i++ ) build_chunk( i );
+
+    /* the levels go one after the other, the ranges are kept in the order of the geometries */
+    _lod_ranges.assign( LOD_LEVELS * _geometries.size(), { 0, 0, 0, 0 } );
+
+    for ( uint32_t level = 0; level < LOD_LEVELS; level++ ) {
+      for ( size_t c = 0; c < num_chunks; c++ ) {
+        LodBuffers& chunk = chunks[c];
+        uint64_t triangle_base = triangles.size(), outline_base = outlines.size();
+
+        for ( size_t i = 0; i < chunk.ranges[level].size(); i++ ) {
+          IndexRange range = chunk.ranges[level][i];
+          range.triangle_offset += triangle_base;
+          range.outline_offset += outline_base;
+
+          _lod_ranges[level * _geometries.size() + _index.item( (uint32_t)( c * LOD_CHUNK_GEOMETRIES + i ) )] = range;
         }
+
+        triangles.insert( triangles.end(), chunk.triangles[level].begin(), chunk.triangles[level].end() );
+        outlines.insert( outlines.end(), chunk.outlines[level].begin(), chunk.outlines[level].end() );
+
+        /* release the memory of the chunk as soon as it is merged */
+        chunk.triangles[level] = std::vector<uint32_t>();
+        chunk.outlines[level] = std::vector<uint32_t>();
+        chunk.ranges[level] = std::vector<IndexRange>();
       }
     }
+  }
+
+  void MapLayer::make_vertex_buffer( Ref<Geometry> geometry, std::vector<Vertex>& vertices ) {
+
+    polygon_id id = geometry->id();
 
-    /* return the list of outlines */
-    return outlines;
+    /* improve performance */
+    vertices.reserve( vertices.size() + geometry->vertices() );
+
+    /* one vertex for every position, in the order of the flat array */
+    for ( const auto& position : geometry->positions() ) {
+      vertices.push_back( { grid_cell( position ), id } );
+    }
+  }
+
+  void MapLayer::make_index_buffers( Ref<Geometry> geometry, uint32_t polygon, uint32_t base_vertex, std::vector<uint32_t>& triangles, std::vector<uint32_t>& outlines ) {
+
+    Polygon view = geometry->polygon( polygon );
+
+    /* triangulate the polygon with the context of this thread, */
+    /* the indices are combined indices in the geometry         */
+    const std::vector<vertex_index>& indices = Triangulator::get().triangulate( view );
+
+    triangles.reserve( triangles.size() + indices.size() );
+    for ( const auto& index : indices )
+      triangles.push_back( base_vertex + index );
+
+    /* every sub-polygon is a strip which connects the last vertex */
+    /* with the first, the restart index ends the strip            */
+    uint32_t first = base_vertex + view.vertex_offset();
+    for ( const auto& sub_polygon : view ) {
+      if ( sub_polygon.vertices() == 0 )
+        continue;
+
+      for ( uint32_t i = 0; i < sub_polygon.vertices(); i++ )
+        outlines.push_back( first + i );
+
+      outlines.push_back( first );
+      outlines.push_back( IndexBuffer::RESTART );
+
+      first += sub_polygon.vertices();
+    }
   }
 
-  std::vector<vertex_index> MapLayer::triangulate( Ref<Geometry> geometry ) {
+  void MapLayer::make_lod_buffers( Ref<Geometry> geometry, uint32_t base_vertex, LodBuffers& lods ) {
 
-    /* triangulated indices */
-    std::vector<vertex_index> triangulated_indices;
+    for ( uint32_t level = 0; level < LOD_LEVELS; level++ )
+      lods.ranges[level].push_back( { lods.triangles[level].size(), lods.outlines[level].size(), 0, 0 } );
 
-    /* offset for each sub-polygon */
-    size_t index_offset = 0;
+    /* the vertices of every ring kept by the previous level and their */
+    /* number, every level simplifies the level before it              */
+    std::vector<vertex_index> kept, simplified;
+    std::vector<uint32_t>     ring_sizes, simplified_sizes, triangles;
 
     for ( const auto& polygon : *geometry ) {
-      /* 2d coordinate */
-      using Point = std::array<float, 2>;
+      kept.resize( polygon.vertices() );
+      std::iota( kept.begin(), kept.end(), polygon.vertex_offset() );
+
+      ring_sizes.clear();
+      for ( const auto& sub_polygon : polygon )
+        ring_sizes.push_back( sub_polygon.vertices() );
+
+      for ( uint32_t level = 0; level < LOD_LEVELS; level++ ) {
+        simplified.clear();
+        simplified_sizes.clear();
+
+        uint32_t offset = 0;
+        for ( size_t ring = 0; ring < ring_sizes.size(); offset += ring_sizes[ring++] ) {
+          const auto& vertices = Simplifier::get().simplify( geometry->positions().data(), kept.data() + offset, ring_sizes[ring], _lod_tolerances[level] );
+
+          /* a hole within the tolerance is dropped, the whole */
+          /* polygon is dropped with its outer ring            */
+          if ( vertices.empty() ) {
+            if ( ring == 0 )
+              break;
+            continue;
+          }
+
+          simplified.insert( simplified.end(), vertices.begin(), vertices.end() );
+          simplified_sizes.push_back( (uint32_t)vertices.size() );
+        }
+
+        /* the coarser levels cannot bring it back */
+        if ( simplified_sizes.empty() )
+          break;
 
-      /* a collection of sub-polygons */
-      std::vector<std::vector<Point>> polygons;
+        /* the triangles of the previous level are still good if no vertex was removed */
+        bool changed = level == 0 || simplified.size() != kept.size();
 
-      /* size of positions array */
-      size_t positions_size = 0;
+        std::swap( kept, simplified );
+        std::swap( ring_sizes, simplified_sizes );
 
-      for ( const auto& sub_polygon : polygon ) {
-        /* array to hold positions in the sub-polygon */
-        std::vector<Point> positions;
-        positions.reserve( sub_polygon.vertices() );
+        if ( changed ) {
+          const std::vector<vertex_index>& indices = Triangulator::get().triangulate( *geometry, kept, ring_sizes );
 
-        /* poppulate the array */
-        for ( const auto& position : sub_polygon ) {
-          positions.push_back( { position.x, position.y } );
-          positions_size++;
+          triangles.clear();
+          for ( const auto& index : indices )
+            triangles.push_back( base_vertex + index );
         }
 
-        /* insert in the list of sub-polygons */
-        polygons.push_back( positions );
-      }
+        lods.triangles[level].insert( lods.triangles[level].end(), triangles.begin(), triangles.end() );
 
-      /* triangulate */
-      std::vector<vertex_index> indices = mapbox::earcut<vertex_index>( polygons );
+        /* the outlines are strips of the kept vertices like the full resolution */
+        uint32_t first = 0;
+        for ( uint32_t size : ring_sizes ) {
+          for ( uint32_t i = 0; i < size; i++ )
+            lods.outlines[level].push_back( base_vertex + kept[first + i] );
 
-      /* push the indices in the combined list of indices */
-      for ( const auto& index : indices ) {
-        triangulated_indices.push_back( index + index_offset );
-      }
+          lods.outlines[level].push_back( base_vertex + kept[first] );
+          lods.outlines[level].push_back( IndexBuffer::RESTART );
 
-      /* increase offset for next sub-polygon */
-      index_offset += positions_size;
+          first += size;
+        }
+      }
     }
 
-    /* return triangulated indices */
-    return triangulated_indices;
+    for ( uint32_t level = 0; level < LOD_LEVELS; level++ ) {
+      IndexRange& range = lods.ranges[level].back();
+      range.triangles = lods.triangles[level].size() - range.triangle_offset;
+      range.outlines = lods.outlines[level].size() - range.outline_offset;
+    }
   }
 
 }
@@ -21,6 +21,10 @@ namespace mv {
 
   ApplicationMenu::~ApplicationMenu( void ) {}
 
+  void ApplicationMenu::update( float delta_time ) {
+    update_layer_loaders();
+  }
+
   void ApplicationMenu::on_imgui_render( void ) {
     draw_menubar();
     init_dockspace();
@@ -176,10 +180,7 @@ namespace mv {
       if ( ImGui::BeginDragDropTarget() ) {
         if ( const ImGuiPayload* payload = ImGui::AcceptDragDropPayload( "DND_FILE_CB" ) ) {
           string file_path = (const char*)payload->Data;
-          Ref<MapLayer> layer = new MapLayer( file_path );
-          if ( !layer->empty() ) {
-            _map_layers->push_back( layer );
-          }
+          _layer_loaders.push_back( new LayerLoader( file_path ) );
         }
         ImGui::EndDragDropTarget();
       }
@@ -191,12 +192,7 @@ namespace mv {
         ImGui::InputText( "Path", &path );
 
         if ( ImGui::Button( "Load Layer" ) ) {
-          Ref<MapLayer> layer = new MapLayer("../../../../json/" + path + ".geojson" );
-
-          if ( !layer->empty() ) {
-            _map_layers->push_back( layer );
-          }
-
+          _layer_loaders.push_back( new LayerLoader( "../../../../json/" + path + ".geojson" ) );
         }
         ImGui::SameLine();
 
@@ -240,10 +236,19 @@ namespace mv {
         ImGui::Separator();
       }
 
+      draw_layer_loaders();
+
       auto layer_props = [&] ( Ref<MapLayer> item ) -> void {
 
         if ( ImGui::BeginPopup( "Layer Properties", ImGuiWindowFlags_AlwaysAutoResize ) ) {
           ImGui::Text( "Layer Name: %s", item->name().c_str() );
+
+          const TriangulationStats& triangulation = item->triangulation_stats();
+          if ( triangulation.fan_rings + triangulation.earcut_rings > 0 ) {
+            ImGui::Text( "Convex Rings: %zu", triangulation.fan_rings );
+            ImGui::Text( "Earcut Rings: %zu", triangulation.earcut_rings );
+          }
+
           ImGui::Separator();
 
           glm::vec4 fill_color = item->get_polygon_fill_color();
@@ -366,6 +371,67 @@ namespace mv {
 
   }
 
+  void ApplicationMenu::update_layer_loaders( void ) {
+    /* bytes uploaded to the GPU per frame by every loader */
+    static const size_t upload_budget = 4 * 1024 * 1024;
+
+    for ( auto it = _layer_loaders.begin(); it != _layer_loaders.end(); ) {
+      Ref<LayerLoader> loader = *it;
+
+      LayerLoader::Stage previous = loader->stage();
+      LayerLoader::Stage stage = loader->update( upload_budget );
+
+      /* show the layer as soon as it is parsed, it fills in while uploading */
+      if ( previous == LayerLoader::Stage::Parsing && ( stage == LayerLoader::Stage::Uploading || stage == LayerLoader::Stage::Done ) )
+        _map_layers->push_back( loader->layer() );
+
+      if ( stage == LayerLoader::Stage::Failed )
+        LOG_ERROR( "failed to load layer: {}", loader->filename() );
+
+      if ( stage != LayerLoader::Stage::Parsing && stage != LayerLoader::Stage::Uploading ) {
+        it = _layer_loaders.erase( it );
+        continue;
+      }
+
+      it++;
+    }
+  }
+
+  void ApplicationMenu::draw_layer_loaders( void ) {
+
+    for ( auto& loader : _layer_loaders ) {
+      /* a loader cancelled earlier in this frame is removed on the next update */
+      LayerLoader::Stage stage = loader->stage();
+      if ( stage != LayerLoader::Stage::Parsing && stage != LayerLoader::Stage::Uploading )
+        continue;
+
+      ImGui::PushID( loader->filename().c_str() );
+
+      string overlay = stage == LayerLoader::Stage::Parsing ? "Parsing " : "Uploading ";
+      overlay += loader->filename().substr( loader->filename().find_last_of( "/\\" ) + 1 );
+
+      ImGui::ProgressBar( loader->progress(), ImVec2( -ImGui::GetFrameHeight() - ImGui::GetStyle().ItemSpacing.x, 0.0f ), overlay.c_str() );
+      ImGui::SameLine();
+
+      if ( ImGui::Button( "X", ImVec2( ImGui::GetFrameHeight(), ImGui::GetFrameHeight() ) ) ) {
+        /* a partially uploaded layer is already in the list */
+        Ref<MapLayer> layer = loader->layer();
+        if ( layer != nullptr ) {
+          _map_layers->erase( std::remove( _map_layers->begin(), _map_layers->end(), layer ), _map_layers->end() );
+          if ( _selected_layer == layer )
+            _selected_layer = nullptr;
+        }
+
+        loader->cancel();
+      }
+
+      ImGui::PopID();
+    }
+
+    if ( !_layer_loaders.empty() )
+      ImGui::Separator();
+  }
+
   void ApplicationMenu::draw_renderstate_menu( void ) {
     if ( ImGui::Begin( "Viewport Settings", &_show_renderstate_menu ) ) {
       if ( ImGui::CollapsingHeader( "Renderstate Perfomance" ) ) {
@@ -390,6 +456,7 @@ namespace mv {
         ImGui::Text( "FPS: %f", Timer::fps() );
         ImGui::Text( "Delta Time: %f", dt );
         ImGui::Text( "Draw Calls: %u", stat.draw_calls );
+        ImGui::Text( "Input Layouts Created: %u", stat.input_layouts );
 
         ImGui::Indent();
 
@@ -399,6 +466,27 @@ namespace mv {
 
         ImGui::Unindent();
 
+        /* the edits of the layers move their buffers, these count since the start */
+        const BufferStats& buffers = buffer_stats();
+
+        ImGui::Text( "Buffer Reallocations: %u", buffers.reallocations );
+        ImGui::Text( "Buffer Shifts: %u", buffers.shifts );
+        ImGui::Text( "Buffer Bytes Copied: %zu", buffers.bytes_copied );
+
+        /* the free blocks left in the buffers of the selected layer by its edits */
+        if ( _selected_layer != nullptr ) {
+          BlockAllocator::Stats triangles = _selected_layer->triangle_block_stats();
+          BlockAllocator::Stats outlines = _selected_layer->outline_block_stats();
+          BlockAllocator::Stats vertices = _selected_layer->vertex_block_stats();
+
+          ImGui::Text( "Free Vertices: %zu in %zu blocks", vertices.free, vertices.free_blocks );
+          ImGui::Text( "Free Triangle Indices: %zu in %zu blocks (%.1f%% fragmented)", triangles.free, triangles.free_blocks, triangles.fragmentation() * 100.0 );
+          ImGui::Text( "Free Outline Indices: %zu in %zu blocks (%.1f%% fragmented)", outlines.free, outlines.free_blocks, outlines.fragmentation() * 100.0 );
+
+          if ( ImGui::Button( "Compact Layer" ) )
+            _selected_layer->compact();
+        }
+
         bool vsync = GraphicsContext::ref().get_vsync();
 
         if ( ImGui::Checkbox( "VSync", &vsync ) ) {
@@ -498,8 +586,9 @@ namespace mv {
       };
 
       /* insert all the filters for the layer if not inserted */
-      for ( const auto& prop : ( *selected_layer->begin() )->get_props() ) {
-        push_filter( prop.first );
+      const AttributeTable& attributes = selected_layer->attributes();
+      for ( uint32_t column = 0; column < attributes.columns(); column++ ) {
+        push_filter( attributes.column_name( column ) );
       }
     }
 
@@ -538,17 +627,17 @@ namespace mv {
       static int freeze_rows = 1;
 
       /* number of columns to be drawn */
-      uint32_t columns = ( *selected_layer->begin() )->get_props().size();
+      const AttributeTable& attributes = selected_layer->attributes();
+      uint32_t columns = attributes.columns();
 
-      if ( ImGui::BeginTable( " TableAttList", columns, table_flags, ImVec2( 0.0f, 0.5f ) ) ) {
+      if ( columns > 0 && ImGui::BeginTable( " TableAttList", columns, table_flags, ImVec2( 0.0f, 0.5f ) ) ) {
         
         //freeze cols and rows
         ImGui::TableSetupScrollFreeze(freeze_cols, freeze_rows);
 
         /* draw the columns */
-        Ref<Geometry> first = *selected_layer->begin();
-        for ( const auto& prop : first->get_props() )
-          ImGui::TableSetupColumn( prop.first.c_str(), ImGuiTableColumnFlags_WidthFixed );
+        for ( uint32_t column = 0; column < columns; column++ )
+          ImGui::TableSetupColumn( attributes.column_name( column ).c_str(), ImGuiTableColumnFlags_WidthFixed );
 
         /* create the header row */
         ImGui::TableHeadersRow();
@@ -556,6 +645,15 @@ namespace mv {
         /* ensure that the filtering is done */
         _filter_future.wait();
 
+        /* sort again when the order is changed or the rows are filtered again */
+        if ( ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs() ) {
+          if ( sort_specs->SpecsDirty || _resort_attributes ) {
+            sort_attributes( selected_layer, sort_specs );
+            sort_specs->SpecsDirty = false;
+            _resort_attributes = false;
+          }
+        }
+
         /* draw the attributes */
         ImGuiListClipper clipper;
         clipper.Begin( _filtered_polygons.size() );
@@ -563,16 +661,19 @@ namespace mv {
         while ( clipper.Step() ) {
           for ( int32_t row = clipper.DisplayStart; row < clipper.DisplayEnd; row++ ) {
             ImGui::TableNextRow();
-            uint32_t column = 0;
             bool selected = selected_layer->is_selected( _filtered_polygons[row] );
+            size_t attribute_row = selected_layer->attribute_row( _filtered_polygons[row] );
             ImGui::PushID( row );
 
-            for ( const auto& prop : selected_layer->get_geometry( _filtered_polygons[row] )->get_props() ) {
+            for ( uint32_t column = 0; column < columns; column++ ) {
               ImGui::TableSetColumnIndex( column );
 
+              /* the values are converted to text only for the visible rows */
+              string text = attributes.to_string( attribute_row, column );
+
               /* create the row selectable */
               if ( column == 0 ) {
-                if ( ImGui::Selectable( prop.second.c_str(), selected, ImGuiSelectableFlags_SpanAllColumns ) ) {
+                if ( ImGui::Selectable( text.c_str(), selected, ImGuiSelectableFlags_SpanAllColumns ) ) {
                   if ( !ImGui::GetIO().KeyCtrl )
                     selected_layer->clear_selected();
 
@@ -587,8 +688,8 @@ namespace mv {
                   auto fly_to_geom = selected_layer->get_geometry( _filtered_polygons[row] );
                   Box bb = fly_to_geom->bbox();
 
-                  glm::vec3 center = bb.center();
-                  glm::vec3 size   = bb.size();
+                  glm::dvec3 center = bb.center();
+                  glm::dvec3 size   = bb.size();
 
                   glm::vec2 camera_size = _camera->get_size();
 
@@ -598,9 +699,8 @@ namespace mv {
                 }
 
               } else {
-                ImGui::Text( prop.second.c_str() );
+                ImGui::TextUnformatted( text.c_str() );
               }
-              column++;
             }
 
             ImGui::PopID();
@@ -633,8 +733,10 @@ namespace mv {
       ImGui::Separator();
 
       /* draw the filters */
-      for ( const auto& prop : ( *selected_layer->begin() )->get_props() ) {
-        if ( _attribute_filters[prop.first].Draw( prop.first.c_str() ) ) {
+      const AttributeTable& attributes = selected_layer->attributes();
+      for ( uint32_t column = 0; column < attributes.columns(); column++ ) {
+        const string& name = attributes.column_name( column );
+        if ( _attribute_filters[name].Draw( name.c_str() ) ) {
           _refilter_attributes = true;
         }
       }
@@ -643,29 +745,52 @@ namespace mv {
     ImGui::End();
 
     static auto filter_async = [&] ( std::vector<polygon_id>* ids, Ref<MapLayer> selected_layer, const bool filter_selected_only ) -> void {
+      const AttributeTable& attributes = selected_layer->attributes();
 
-      if ( filter_selected_only && selected_layer->selected_geometries().size() > 0 ) {
-        for ( const auto& geometry : selected_layer->selected_geometries() ) {
-          bool filter_pass = true;
+      struct ColumnFilter {
+        uint32_t               column;
+        const ImGuiTextFilter* filter;
 
-          for ( const auto& prop : selected_layer->get_geometry( geometry )->get_props() ) {
-            if ( !_attribute_filters[prop.first].PassFilter( prop.second.c_str() ) )
-              filter_pass = false;
-          }
+        /* result for every code of a dictionary encoded column */
+        std::vector<bool> codes;
+      };
+
+      /* only the columns with an active filter are looked at, the strings */
+      /* of an encoded column are tested once for every distinct value      */
+      std::vector<ColumnFilter> filters;
+      for ( uint32_t column = 0; column < attributes.columns(); column++ ) {
+        auto it = _attribute_filters.find( attributes.column_name( column ) );
+        if ( it == _attribute_filters.end() || !it->second.IsActive() )
+          continue;
+
+        ColumnFilter& filter = filters.emplace_back( ColumnFilter{ column, &it->second } );
+        if ( attributes.is_dictionary( column ) ) {
+          filter.codes.resize( attributes.dictionary_size( column ) );
+          for ( uint32_t code = 0; code < (uint32_t)filter.codes.size(); code++ )
+            filter.codes[code] = filter.filter->PassFilter( attributes.dictionary_value( column, code ).c_str() );
+        }
+      }
 
-          if ( filter_pass )
+      auto filter_pass = [&] ( polygon_id id ) -> bool {
+        size_t row = selected_layer->attribute_row( id );
+        for ( const auto& filter : filters ) {
+          bool pass = attributes.is_dictionary( filter.column ) && attributes.type( row, filter.column ) == AttributeType::String ?
+                      filter.codes[attributes.code( row, filter.column )] :
+                      filter.filter->PassFilter( attributes.to_string( row, filter.column ).c_str() );
+          if ( !pass )
+            return false;
+        }
+        return true;
+      };
+
+      if ( filter_selected_only && selected_layer->selected_geometries().size() > 0 ) {
+        for ( const auto& geometry : selected_layer->selected_geometries() ) {
+          if ( filter_pass( geometry ) )
             ids->push_back( geometry );
         }
       } else {
         for ( const auto& geometry : *selected_layer ) {
-          bool filter_pass = true;
-
-          for ( const auto& prop : geometry->get_props() ) {
-            if ( !_attribute_filters[prop.first].PassFilter( prop.second.c_str() ) )
-              filter_pass = false;
-          }
-
-          if ( filter_pass )
+          if ( filter_pass( geometry->id() ) )
             ids->push_back( geometry->id() );
         }
       }
@@ -679,6 +804,32 @@ namespace mv {
       _filter_future = std::async( std::launch::async, filter_async, &_filtered_polygons, selected_layer, filter_selected );
 
       _refilter_attributes = false;
+      _resort_attributes = true;
     }
   }
+
+  void ApplicationMenu::sort_attributes( Ref<MapLayer> selected_layer, const ImGuiTableSortSpecs* sort_specs ) {
+    const AttributeTable& attributes = selected_layer->attributes();
+
+    /* the strings of an encoded column are ordered by the rank of their code */
+    std::vector<std::vector<uint32_t>> ranks( sort_specs->SpecsCount );
+    for ( int32_t i = 0; i < sort_specs->SpecsCount; i++ ) {
+      uint32_t column = (uint32_t)sort_specs->Specs[i].ColumnIndex;
+      if ( attributes.is_dictionary( column ) )
+        ranks[i] = attributes.dictionary_ranks( column );
+    }
+
+    /* equal rows and no sort at all keep the order of the ids */
+    std::sort( _filtered_polygons.begin(), _filtered_polygons.end(), [&] ( polygon_id a, polygon_id b ) -> bool {
+      for ( int32_t i = 0; i < sort_specs->SpecsCount; i++ ) {
+        const ImGuiTableColumnSortSpecs& spec = sort_specs->Specs[i];
+        int order = attributes.compare( selected_layer->attribute_row( a ), selected_layer->attribute_row( b ), (uint32_t)spec.ColumnIndex, ranks[i] );
+
+        if ( order != 0 )
+          return spec.SortDirection == ImGuiSortDirection_Ascending ? order < 0 : order > 0;
+      }
+
+      return a < b;
+    } );
+  }
 }
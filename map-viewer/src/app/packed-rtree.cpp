@@ -0,0 +1,191 @@
+#include <app/packed-rtree.h>
+
+#include <limits>
+#include <algorithm>
+
+namespace mv {
+
+  /* levels of nodes above the leaves for 2^32 items */
+  static constexpr size_t MAX_NODE_LEVELS = 8;
+
+  PackedRTree::PackedRTree( void ) {} /* do nothing */
+  PackedRTree::~PackedRTree( void ) {} /* do nothing */
+
+  void PackedRTree::build( const std::vector<Box>& boxes ) {
+    clear();
+
+    if ( boxes.empty() )
+      return;
+
+    uint32_t count = (uint32_t)boxes.size();
+
+    /* the centers of the boxes are mapped to the grid of the curve */
+    glm::dvec2 min = glm::dvec2(  std::numeric_limits<double>::max() );
+    glm::dvec2 max = glm::dvec2( -std::numeric_limits<double>::max() );
+
+    for ( const auto& box : boxes ) {
+      glm::dvec2 center = glm::dvec2( box.center() );
+      min = glm::min( min, center );
+      max = glm::max( max, center );
+    }
+
+    glm::dvec2 extent = max - min;
+    glm::dvec2 scale = glm::dvec2( extent.x > 0.0 ? 65535.0 / extent.x : 0.0, extent.y > 0.0 ? 65535.0 / extent.y : 0.0 );
+
+    /* sort the items by their distance along the curve, the item */
+    /* is in the low bits so that a tie keeps the original order  */
+    std::vector<uint64_t> keys( count );
+    for ( uint32_t item = 0; item < count; item++ ) {
+      glm::dvec2 cell = ( glm::dvec2( boxes[item].center() ) - min ) * scale;
+      keys[item] = (uint64_t)hilbert( (uint32_t)cell.x, (uint32_t)cell.y ) << 32 | item;
+    }
+
+    std::sort( keys.begin(), keys.end() );
+
+    _items.resize( count );
+    _leaves.resize( count );
+    _boxes.reserve( count + count / ( NODE_SIZE - 1 ) + 1 );
+
+    _levels.push_back( 0 );
+    for ( uint32_t leaf = 0; leaf < count; leaf++ ) {
+      uint32_t item = (uint32_t)keys[leaf];
+
+      _items[leaf] = item;
+      _leaves[item] = leaf;
+      _boxes.push_back( { glm::dvec2( boxes[item].min ), glm::dvec2( boxes[item].max ) } );
+    }
+    _levels.push_back( _boxes.size() );
+
+    /* every node covers `NODE_SIZE` consecutive boxes of the level below */
+    while ( _levels.back() - _levels[_levels.size() - 2] > 1 ) {
+      uint32_t level = (uint32_t)_levels.size() - 1;
+      size_t nodes = ( _levels[level] - _levels[level - 1] + NODE_SIZE - 1 ) / NODE_SIZE;
+
+      for ( size_t node = 0; node < nodes; node++ ) {
+        _boxes.emplace_back();
+        fit( level, _levels[level] + node );
+      }
+
+      _levels.push_back( _boxes.size() );
+    }
+  }
+
+  void PackedRTree::update( uint32_t item, const Box& box ) {
+    if ( item >= _leaves.size() )
+      return;
+
+    size_t node = _leaves[item];
+    _boxes[node] = { glm::dvec2( box.min ), glm::dvec2( box.max ) };
+
+    /* the parent of a box is found from its position in its level */
+    for ( uint32_t level = 1; level + 1 < _levels.size(); level++ ) {
+      node = _levels[level] + ( node - _levels[level - 1] ) / NODE_SIZE;
+      fit( level, node );
+    }
+  }
+
+  void PackedRTree::query( const Box& box, std::vector<uint32_t>& items ) const {
+    size_t first = items.size();
+    search( { glm::dvec2( box.min ), glm::dvec2( box.max ) }, 0, items );
+
+    for ( size_t i = first; i < items.size(); i++ )
+      items[i] = _items[items[i]];
+  }
+
+  void PackedRTree::query( const glm::dvec2& point, std::vector<uint32_t>& items ) const {
+    size_t first = items.size();
+    search( { point, point }, 0, items );
+
+    for ( size_t i = first; i < items.size(); i++ )
+      items[i] = _items[items[i]];
+  }
+
+  void PackedRTree::query_nodes( const Box& box, uint32_t level, std::vector<uint32_t>& nodes ) const {
+    if ( _levels.empty() )
+      return;
+
+    search( { glm::dvec2( box.min ), glm::dvec2( box.max ) }, std::min( level, levels() - 1 ), nodes );
+  }
+
+  void PackedRTree::clear( void ) {
+    _boxes.clear();
+    _levels.clear();
+    _items.clear();
+    _leaves.clear();
+  }
+
+  uint32_t PackedRTree::hilbert( uint32_t x, uint32_t y ) {
+    constexpr uint32_t n = 1 << 16;
+    uint32_t distance = 0;
+
+    for ( uint32_t s = n / 2; s > 0; s /= 2 ) {
+      uint32_t rx = ( x & s ) > 0;
+      uint32_t ry = ( y & s ) > 0;
+      distance += s * s * ( ( 3 * rx ) ^ ry );
+
+      /* rotate the quadrant so that the curve continues in it */
+      if ( ry == 0 ) {
+        if ( rx == 1 ) {
+          x = n - 1 - x;
+          y = n - 1 - y;
+        }
+
+        std::swap( x, y );
+      }
+    }
+
+    return distance;
+  }
+
+  void PackedRTree::fit( uint32_t level, size_t node ) {
+    size_t first = _levels[level - 1] + ( node - _levels[level] ) * NODE_SIZE;
+    size_t last = std::min<size_t>( first + NODE_SIZE, _levels[level] );
+
+    NodeBox box = _boxes[first];
+    for ( size_t child = first + 1; child < last; child++ ) {
+      box.min = glm::min( box.min, _boxes[child].min );
+      box.max = glm::max( box.max, _boxes[child].max );
+    }
+
+    _boxes[node] = box;
+  }
+
+  void PackedRTree::search( const NodeBox& box, uint32_t level, std::vector<uint32_t>& nodes ) const {
+    if ( _boxes.empty() || !_boxes.back().overlaps( box ) )
+      return;
+
+    uint32_t root_level = levels() - 1;
+    if ( root_level == level ) {
+      nodes.push_back( 0 );
+      return;
+    }
+
+    /* the nodes left to visit, a node adds at most all its children */
+    std::pair<uint32_t, size_t> stack[NODE_SIZE * ( MAX_NODE_LEVELS + 1 )];
+    size_t size = 0;
+
+    stack[size++] = { root_level, _boxes.size() - 1 };
+
+    while ( size > 0 ) {
+      auto [parent_level, node] = stack[--size];
+
+      size_t first = _levels[parent_level - 1] + ( node - _levels[parent_level] ) * NODE_SIZE;
+      size_t last = std::min<size_t>( first + NODE_SIZE, _levels[parent_level] );
+
+      /* the children go on the stack from the last so that they come out in order */
+      for ( size_t child = last; child-- > first; ) {
+        if ( !_boxes[child].overlaps( box ) )
+          continue;
+
+        stack[size++] = { parent_level - 1, child };
+      }
+
+      /* the nodes of `level` are reported as they come out */
+      while ( size > 0 && stack[size - 1].first == level ) {
+        nodes.push_back( (uint32_t)( stack[size - 1].second - _levels[level] ) );
+        size--;
+      }
+    }
+  }
+
+}
@@ -0,0 +1,101 @@
+#include <app/simplifier.h>
+
+namespace mv {
+
+  Simplifier::Simplifier( void ) {} /* do nothing */
+  Simplifier::~Simplifier( void ) {} /* do nothing */
+
+  Simplifier& Simplifier::get( void ) {
+    /* the workers of the thread pool keep theirs across loads */
+    static thread_local Simplifier simplifier;
+    return simplifier;
+  }
+
+  const std::vector<vertex_index>& Simplifier::simplify( const glm::dvec3* positions, const vertex_index* ring, uint32_t vertices, double tolerance ) {
+    _kept.clear();
+
+    if ( vertices < 3 )
+      return _kept;
+
+    /* position of the vertex at `i` in the ring, `vertices` is the first again */
+    auto position = [&] ( uint32_t i ) -> const glm::dvec3& { return positions[ring[i < vertices ? i : 0]]; };
+
+    double tolerance2 = tolerance * tolerance;
+
+    /* a closed ring has no segment to start from, it is split at the */
+    /* vertex furthest from the first one                             */
+    uint32_t furthest = 0;
+    double furthest_distance2 = 0.0;
+    for ( uint32_t i = 1; i < vertices; i++ ) {
+      glm::dvec3 delta = position( i ) - position( 0 );
+      double d2 = delta.x * delta.x + delta.y * delta.y;
+
+      if ( d2 > furthest_distance2 ) {
+        furthest = i;
+        furthest_distance2 = d2;
+      }
+    }
+
+    /* the whole ring is within the tolerance of one point */
+    if ( furthest_distance2 <= tolerance2 )
+      return _kept;
+
+    _keep.assign( vertices, 0 );
+    _keep[0] = _keep[furthest] = 1;
+
+    _stack.clear();
+    _stack.push_back( { 0, furthest } );
+    _stack.push_back( { furthest, vertices } );
+
+    /* keep the vertex furthest from the segment of every span if it */
+    /* is out of the tolerance and split the span at it              */
+    while ( !_stack.empty() ) {
+      auto [first, last] = _stack.back();
+      _stack.pop_back();
+
+      uint32_t split = 0;
+      double split_distance2 = tolerance2;
+
+      for ( uint32_t i = first + 1; i < last; i++ ) {
+        double d2 = distance2( position( i ), position( first ), position( last ) );
+
+        if ( d2 > split_distance2 ) {
+          split = i;
+          split_distance2 = d2;
+        }
+      }
+
+      if ( split == 0 )
+        continue;
+
+      _keep[split] = 1;
+      _stack.push_back( { first, split } );
+      _stack.push_back( { split, last } );
+    }
+
+    for ( uint32_t i = 0; i < vertices; i++ ) {
+      if ( _keep[i] )
+        _kept.push_back( ring[i] );
+    }
+
+    /* two vertices are only a line */
+    if ( _kept.size() < 3 )
+      _kept.clear();
+
+    return _kept;
+  }
+
+  double Simplifier::distance2( const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b ) {
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double px = p.x - a.x, py = p.y - a.y;
+
+    /* project on the segment and clamp to its ends */
+    double length2 = dx * dx + dy * dy;
+    double t = length2 > 0.0 ? glm::clamp( ( px * dx + py * dy ) / length2, 0.0, 1.0 ) : 0.0;
+
+    px -= t * dx;
+    py -= t * dy;
+    return px * px + py * py;
+  }
+
+}
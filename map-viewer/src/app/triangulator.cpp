@@ -0,0 +1,114 @@
+#include <app/triangulator.h>
+
+namespace mv {
+
+  Triangulator::Triangulator( void ) {} /* do nothing */
+  Triangulator::~Triangulator( void ) {} /* do nothing */
+
+  Triangulator& Triangulator::get( void ) {
+    /* the workers of the thread pool keep theirs across loads */
+    static thread_local Triangulator triangulator;
+    return triangulator;
+  }
+
+  const std::vector<vertex_index>& Triangulator::triangulate( const Polygon& polygon ) {
+    _rings.clear();
+    for ( const auto& sub_polygon : polygon )
+      _rings.push_back( { sub_polygon.begin(), nullptr, sub_polygon.vertices() } );
+
+    std::vector<vertex_index>& indices = triangulate_rings();
+
+    /* the rings count the vertices from the start of the polygon */
+    vertex_index offset = polygon.vertex_offset();
+    for ( auto& index : indices )
+      index += offset;
+
+    return indices;
+  }
+
+  const std::vector<vertex_index>& Triangulator::triangulate( const Geometry& geometry, const std::vector<vertex_index>& vertices, const std::vector<uint32_t>& ring_sizes ) {
+    _rings.clear();
+
+    uint32_t offset = 0;
+    for ( uint32_t size : ring_sizes ) {
+      _rings.push_back( { geometry.positions().data(), vertices.data() + offset, size } );
+      offset += size;
+    }
+
+    std::vector<vertex_index>& indices = triangulate_rings();
+
+    /* the rings count the vertices in `vertices` */
+    for ( auto& index : indices )
+      index = vertices[index];
+
+    return indices;
+  }
+
+  std::vector<vertex_index>& Triangulator::triangulate_rings( void ) {
+
+    /* a convex ring is a fan of triangles from its first vertex */
+    if ( _rings.size() == 1 && is_convex( _rings[0] ) ) {
+      uint32_t vertices = _rings[0].vertices;
+
+      _indices.clear();
+      for ( vertex_index i = 1; i + 1 < vertices; i++ ) {
+        _indices.push_back( 0 );
+        _indices.push_back( i );
+        _indices.push_back( i + 1 );
+      }
+
+      _stats.fan_rings++;
+      return _indices;
+    }
+
+    _earcut( PolygonView { _rings } );
+
+    _stats.earcut_rings += _rings.size();
+    return _earcut.indices;
+  }
+
+  bool Triangulator::is_convex( const RingView& ring ) {
+    uint32_t vertices = ring.vertices;
+
+    if ( vertices < 3 )
+      return false;
+
+    /* every turn must be to the same side */
+    double side = 0.0;
+
+    /* a simple convex ring changes the direction along x and y twice at most, */
+    /* a star turns to the same side at every vertex but changes more often    */
+    int x_changes = 0, y_changes = 0;
+    double last_dx = 0.0, last_dy = 0.0;
+
+    for ( uint32_t i = 0; i < vertices; i++ ) {
+      const glm::dvec3& a = ring[i];
+      const glm::dvec3& b = ring[( i + 1 ) % vertices];
+      const glm::dvec3& c = ring[( i + 2 ) % vertices];
+
+      double dx = b.x - a.x, dy = b.y - a.y;
+      double cross = dx * ( c.y - b.y ) - dy * ( c.x - b.x );
+
+      if ( cross == 0.0 || ( side != 0.0 && ( cross > 0.0 ) != ( side > 0.0 ) ) )
+        return false;
+      side = cross;
+
+      if ( dx != 0.0 ) {
+        if ( last_dx != 0.0 && ( dx > 0.0 ) != ( last_dx > 0.0 ) )
+          x_changes++;
+        last_dx = dx;
+      }
+
+      if ( dy != 0.0 ) {
+        if ( last_dy != 0.0 && ( dy > 0.0 ) != ( last_dy > 0.0 ) )
+          y_changes++;
+        last_dy = dy;
+      }
+    }
+
+    /* A ring winding around more than once changes at least four times, */
+    /* skipping the change from the last edge to the first misses one.   */
+    return x_changes <= 2 && y_changes <= 2;
+  }
+
+}
@@ -10,6 +10,7 @@
 #include <core/window.h>
 #include <core/timer.h>
 #include <core/input.h>
+#include <core/thread-pool.h>
 
 #include <graphics/context.h>
 #include <graphics/renderstate.h>
@@ -21,6 +22,9 @@ namespace mv {
     /* initialize logger */
     Log::init();
 
+    /* create the worker threads */
+    ThreadPool::create_instance();
+
     /* create window instance */
     Window::create_instance( width, height, name );
     Window::ref().bind_event_func( BIND_EVENT_FN( Core::on_event ) );
@@ -60,6 +64,7 @@ namespace mv {
     ImGuiContext::destory_instance();
     GraphicsContext::destory_instance();
     Window::destory_instance();
+    ThreadPool::destory_instance();
   }
 
   void Core::run( void ) {
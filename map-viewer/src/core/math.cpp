@@ -0,0 +1,85 @@
+#include <core/math.h>
+
+#include <algorithm>
+
+#if defined( __AVX__ )
+  #include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+  #include <emmintrin.h>
+#endif
+
+namespace mv {
+
+  static_assert( sizeof( glm::dvec3 ) == 3 * sizeof( double ), "the positions are read as one array of coordinates" );
+
+  void Box::include( const glm::dvec3* positions, size_t count ) {
+    const double* coordinates = &positions[0].x;
+    size_t i = 0;
+
+    /* The positions are read a few at a time as consecutive coordinates,  */
+    /* every register keeps the same coordinate in the same lane, so the   */
+    /* lanes are only sorted out into x, y and z once at the end.          */
+#if defined( __AVX__ )
+    /* four positions are three registers: x y z x | y z x y | z x y z */
+    if ( count >= 4 ) {
+      __m256d min0 = _mm256_loadu_pd( coordinates );
+      __m256d min1 = _mm256_loadu_pd( coordinates + 4 );
+      __m256d min2 = _mm256_loadu_pd( coordinates + 8 );
+      __m256d max0 = min0, max1 = min1, max2 = min2;
+
+      for ( i = 4; i + 4 <= count; i += 4 ) {
+        const double* next = coordinates + i * 3;
+        __m256d a = _mm256_loadu_pd( next );
+        __m256d b = _mm256_loadu_pd( next + 4 );
+        __m256d c = _mm256_loadu_pd( next + 8 );
+
+        min0 = _mm256_min_pd( min0, a ); max0 = _mm256_max_pd( max0, a );
+        min1 = _mm256_min_pd( min1, b ); max1 = _mm256_max_pd( max1, b );
+        min2 = _mm256_min_pd( min2, c ); max2 = _mm256_max_pd( max2, c );
+      }
+
+      double lanes_min[12], lanes_max[12];
+      _mm256_storeu_pd( lanes_min, min0 ); _mm256_storeu_pd( lanes_min + 4, min1 ); _mm256_storeu_pd( lanes_min + 8, min2 );
+      _mm256_storeu_pd( lanes_max, max0 ); _mm256_storeu_pd( lanes_max + 4, max1 ); _mm256_storeu_pd( lanes_max + 8, max2 );
+
+      for ( int lane = 0; lane < 12; lane++ ) {
+        min[lane % 3] = std::min( min[lane % 3], lanes_min[lane] );
+        max[lane % 3] = std::max( max[lane % 3], lanes_max[lane] );
+      }
+    }
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+    /* two positions are three registers: x y | z x | y z */
+    if ( count >= 2 ) {
+      __m128d min0 = _mm_loadu_pd( coordinates );
+      __m128d min1 = _mm_loadu_pd( coordinates + 2 );
+      __m128d min2 = _mm_loadu_pd( coordinates + 4 );
+      __m128d max0 = min0, max1 = min1, max2 = min2;
+
+      for ( i = 2; i + 2 <= count; i += 2 ) {
+        const double* next = coordinates + i * 3;
+        __m128d a = _mm_loadu_pd( next );
+        __m128d b = _mm_loadu_pd( next + 2 );
+        __m128d c = _mm_loadu_pd( next + 4 );
+
+        min0 = _mm_min_pd( min0, a ); max0 = _mm_max_pd( max0, a );
+        min1 = _mm_min_pd( min1, b ); max1 = _mm_max_pd( max1, b );
+        min2 = _mm_min_pd( min2, c ); max2 = _mm_max_pd( max2, c );
+      }
+
+      double lanes_min[6], lanes_max[6];
+      _mm_storeu_pd( lanes_min, min0 ); _mm_storeu_pd( lanes_min + 2, min1 ); _mm_storeu_pd( lanes_min + 4, min2 );
+      _mm_storeu_pd( lanes_max, max0 ); _mm_storeu_pd( lanes_max + 2, max1 ); _mm_storeu_pd( lanes_max + 4, max2 );
+
+      for ( int lane = 0; lane < 6; lane++ ) {
+        min[lane % 3] = std::min( min[lane % 3], lanes_min[lane] );
+        max[lane % 3] = std::max( max[lane % 3], lanes_max[lane] );
+      }
+    }
+#endif
+
+    /* the positions left over, or all of them without vector instructions */
+    for ( ; i < count; i++ )
+      include( positions[i] );
+  }
+
+}
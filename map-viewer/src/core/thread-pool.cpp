@@ -0,0 +1,123 @@
+#include <core/thread-pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <exception>
+
+#include <utils/logger.h>
+#include <debug/profiler.h>
+
+namespace mv {
+
+  ThreadPool::ThreadPool( uint32_t num_threads ) {
+    if ( num_threads == 0 )
+      num_threads = std::max( std::thread::hardware_concurrency(), 1u );
+
+    LOG_INFO( "Creating thread pool with {} threads", num_threads );
+
+    for ( uint32_t i = 0; i < num_threads; i++ )
+      _workers.emplace_back( &ThreadPool::worker_loop, this );
+  }
+
+  ThreadPool::~ThreadPool( void ) {
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stop = true;
+    }
+
+    /* wake everyone up, the remaining tasks are finished before exiting */
+    _condition.notify_all();
+
+    for ( auto& worker : _workers )
+      worker.join();
+  }
+
+  void ThreadPool::submit( std::function<void( void )> task ) {
+    {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _tasks.push( std::move( task ) );
+    }
+
+    _condition.notify_one();
+  }
+
+  void ThreadPool::parallel_for( size_t count, const std::function<void( size_t )>& func ) {
+    PROFILE_FUNCTION();
+
+    if ( count == 0 )
+      return;
+
+    /* The state is shared with the helper tasks, a helper which starts late */
+    /* (after all the indices are taken) simply finds nothing to do, so the  */
+    /* state must outlive this function.                                     */
+    struct State {
+      std::function<void( size_t )> func;
+      std::atomic<size_t>           next { 0 };
+      size_t                        count = 0;
+      size_t                        done  = 0;
+      std::exception_ptr            error;
+      std::mutex                    mutex;
+      std::condition_variable       finished;
+    };
+
+    auto state = std::make_shared<State>();
+    state->func  = func;
+    state->count = count;
+
+    auto run = [] ( const std::shared_ptr<State>& state ) -> void {
+      size_t index;
+      while ( ( index = state->next++ ) < state->count ) {
+        std::exception_ptr error;
+
+        try {
+          state->func( index );
+        } catch ( ... ) {
+          error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock( state->mutex );
+        if ( error && !state->error )
+          state->error = error;
+
+        if ( ++state->done == state->count )
+          state->finished.notify_all();
+      }
+    };
+
+    /* one helper per worker is enough, every helper keeps taking indices */
+    size_t helpers = std::min( count - 1, _workers.size() );
+    for ( size_t i = 0; i < helpers; i++ )
+      submit( [state, run] () -> void { run( state ); } );
+
+    /* work on the calling thread as well */
+    run( state );
+
+    /* wait for the indices taken by the workers */
+    std::unique_lock<std::mutex> lock( state->mutex );
+    state->finished.wait( lock, [&] () -> bool { return state->done == state->count; } );
+
+    if ( state->error )
+      std::rethrow_exception( state->error );
+  }
+
+  void ThreadPool::worker_loop( void ) {
+    while ( true ) {
+      std::function<void( void )> task;
+
+      {
+        std::unique_lock<std::mutex> lock( _mutex );
+        _condition.wait( lock, [&] () -> bool { return _stop || !_tasks.empty(); } );
+
+        if ( _stop && _tasks.empty() )
+          return;
+
+        task = std::move( _tasks.front() );
+        _tasks.pop();
+      }
+
+      task();
+    }
+  }
+
+}
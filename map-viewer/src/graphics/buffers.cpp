@@ -1,10 +1,15 @@
 #include <graphics/buffers.h>
 
+#include <algorithm>
+
 #include <glad/glad.h>
 
 #include <utils/logger.h>
 #include <utils/exception.h>
 
+#include <graphics/shaders.h>
+#include <graphics/renderstate.h>
+
 namespace mv {
 
   size_t get_size_in_bytes( VertexDataType type ) {
@@ -73,6 +78,7 @@ namespace mv {
     PROFILE_FUNCTION();
 
     LOG_INFO( "deleted opengl vertex buffer: id = {}", buffer_id );
+    Shader::release_input_layouts( buffer_id );
     glDeleteBuffers( 1, &buffer_id );
   }
 
@@ -103,77 +109,162 @@ namespace mv {
     glNamedBufferSubData( buffer_id, (GLintptr)offset, size, data );
   }
 
-  uint32_t insert_in_vertex_buffer( uint32_t buffer_id, size_t offset, size_t size, const void* data ) {
+  uint32_t create_persistent_buffer( size_t size_in_bytes, const void* data, void** mapped ) {
     PROFILE_FUNCTION();
 
-    MV_ASSERT( buffer_id != 0 );
+    GLuint id = 0;
 
-    /* get the old buffer size */
-    GLint64 old_buffer_size = 0;
-    glGetNamedBufferParameteri64v( buffer_id, GL_BUFFER_SIZE, &old_buffer_size );
+    /* allocate the OpenGL buffer object */
+    glCreateBuffers( 1, &id );
+    if ( id == 0 )
+      THROW( "failed to create opengl buffer object" );
 
-    /* assert that the offset is valid */
-    MV_ASSERT( offset <= old_buffer_size );
+    /* the storage can not be resized, it is mapped as long as it lives */
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glNamedBufferStorage( id, size_in_bytes, data, flags );
 
-    /* create a new buffer to hold the combined data */
-    uint32_t new_buffer = create_vertex_buffer( old_buffer_size + size, nullptr );
+    *mapped = glMapNamedBufferRange( id, 0, size_in_bytes, flags );
+    if ( *mapped == nullptr )
+      THROW( "failed to map opengl buffer object" );
 
-    /* copy the old data behind offset */
-    if ( offset != 0 )
-      glCopyNamedBufferSubData( buffer_id, new_buffer, 0, 0, offset );
+    LOG_INFO( "created persistent opengl vertex buffer: id = {}", id );
+    return (uint32_t)id;
+  }
 
-    /* append the new data */
-    glNamedBufferSubData( new_buffer, offset, size, data );
+  void* create_fence( void ) {
+    return glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+  }
 
-    /* copy the old data after offset */
-    if ( offset != old_buffer_size )
-      glCopyNamedBufferSubData( buffer_id, new_buffer, offset, offset + size, old_buffer_size - offset );
+  void wait_fence( void* fence ) {
+    PROFILE_FUNCTION();
 
-    /* delete the old buffer */
-    delete_vertex_buffer( buffer_id );
+    if ( fence == nullptr )
+      return;
 
-    return new_buffer;
+    /* the commands before the fence are flushed so that the wait ends */
+    while ( true ) {
+      GLenum result = glClientWaitSync( (GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 );
+      if ( result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED )
+        break;
+    }
+
+    glDeleteSync( (GLsync)fence );
+  }
+
+  void delete_fence( void* fence ) {
+    if ( fence != nullptr )
+      glDeleteSync( (GLsync)fence );
+  }
+
+  /* Growth of a buffer when it is reallocated, the room left makes the */
+  /* next edits shift the data in place instead of reallocating.        */
+  static constexpr size_t GROWTH_NUMERATOR = 3, GROWTH_DENOMINATOR = 2;
+
+  static BufferStats s_buffer_stats;
+
+  const BufferStats& buffer_stats( void ) {
+    return s_buffer_stats;
+  }
+
+  /* move `size` bytes at `from` to `to` in the same buffer */
+  static void shift_buffer_memory( uint32_t buffer_id, size_t from, size_t to, size_t size ) {
+    s_buffer_stats.shifts++;
+    s_buffer_stats.bytes_copied += size;
+
+    /* a copy within one buffer must not overlap */
+    if ( from + size <= to || to + size <= from ) {
+      glCopyNamedBufferSubData( buffer_id, buffer_id, from, to, size );
+      return;
+    }
+
+    /* otherwise the data goes through the scratch buffer of the render state */
+    uint32_t scratch = RenderState::ref().scratch_buffer( size );
+    glCopyNamedBufferSubData( buffer_id, scratch, from, 0, size );
+    glCopyNamedBufferSubData( scratch, buffer_id, 0, to, size );
   }
 
-  uint32_t replace_vertex_buffer_memory( uint32_t buffer_id, size_t offset, size_t old_size, size_t new_size, const void* data ) {
+  uint32_t insert_in_vertex_buffer( uint32_t buffer_id, size_t& capacity, size_t size, size_t offset, size_t insert_size, const void* data ) {
     PROFILE_FUNCTION();
 
-    MV_ASSERT( buffer_id != 0 );
+    return replace_vertex_buffer_memory( buffer_id, capacity, size, offset, 0, insert_size, data );
+  }
 
-    /* get the old buffer size */
-    GLint64 old_buffer_size = 0;
-    glGetNamedBufferParameteri64v( buffer_id, GL_BUFFER_SIZE, &old_buffer_size );
+  uint32_t replace_vertex_buffer_memory( uint32_t buffer_id, size_t& capacity, size_t size, size_t offset, size_t old_size, size_t new_size, const void* data ) {
+    PROFILE_FUNCTION();
+
+    MV_ASSERT( buffer_id != 0 );
 
     /* assert that the offset and old size is valid */
-    MV_ASSERT( offset + old_size <= old_buffer_size );
+    MV_ASSERT( offset + old_size <= size && size <= capacity );
+
+    size_t tail = size - offset - old_size;
+    size_t new_buffer_size = size - old_size + new_size;
+
+    /* If the new memory fits in the buffer the data after it is moved */
+    /* into place and the same buffer is returned.                     */
+    if ( new_buffer_size <= capacity ) {
+      if ( new_size != old_size && tail != 0 )
+        shift_buffer_memory( buffer_id, offset + old_size, offset + new_size, tail );
+
+      if ( new_size != 0 )
+        glNamedBufferSubData( buffer_id, offset, new_size, data );
 
-    /* If the memory to replace can fit in the buffer, update the */
-    /* old buffer's memory and simply return the same buffer.     */
-    if ( new_size == old_size ) {
-      glNamedBufferSubData( buffer_id, offset, new_size, data );
       return buffer_id;
     }
 
-    /* compute the new size */
-    size_t new_buffer_size = old_buffer_size - old_size + new_size;
+    /* create a new buffer with room to grow */
+    size_t new_capacity = std::max( new_buffer_size, capacity * GROWTH_NUMERATOR / GROWTH_DENOMINATOR );
+    uint32_t new_buffer = create_vertex_buffer( new_capacity, nullptr );
 
-    /* create a new buffer with appropriate size */
-    uint32_t new_buffer = create_vertex_buffer( new_buffer_size, nullptr );
+    s_buffer_stats.reallocations++;
+    s_buffer_stats.bytes_copied += offset + tail;
 
     /* copy the old data behind offset */
     if ( offset != 0 )
       glCopyNamedBufferSubData( buffer_id, new_buffer, 0, 0, offset );
 
     /* copy the new data after offset */
-    glNamedBufferSubData( new_buffer, offset, new_size, data );
+    if ( new_size != 0 )
+      glNamedBufferSubData( new_buffer, offset, new_size, data );
 
     /* copy the old data after old_size */
-    if ( offset != old_buffer_size )
-      glCopyNamedBufferSubData( buffer_id, new_buffer, offset + old_size, offset + new_size, old_buffer_size - offset - old_size );
+    if ( tail != 0 )
+      glCopyNamedBufferSubData( buffer_id, new_buffer, offset + old_size, offset + new_size, tail );
 
     /* delete the old buffer */
     delete_vertex_buffer( buffer_id );
 
+    capacity = new_capacity;
+    return new_buffer;
+  }
+
+  uint32_t gather_vertex_buffer( uint32_t buffer_id, size_t& capacity, size_t size, const std::vector<BufferCopy>& copies ) {
+    PROFILE_FUNCTION();
+
+    MV_ASSERT( buffer_id != 0 );
+
+    uint32_t new_buffer = create_vertex_buffer( size, nullptr );
+
+    s_buffer_stats.reallocations++;
+
+    /* the ranges which follow each other in both buffers are copied at once */
+    for ( size_t i = 0; i < copies.size(); ) {
+      BufferCopy copy = copies[i++];
+
+      while ( i < copies.size() && copies[i].from == copy.from + copy.size && copies[i].to == copy.to + copy.size )
+        copy.size += copies[i++].size;
+
+      MV_ASSERT( copy.to + copy.size <= size );
+
+      if ( copy.size != 0 )
+        glCopyNamedBufferSubData( buffer_id, new_buffer, copy.from, copy.to, copy.size );
+
+      s_buffer_stats.bytes_copied += copy.size;
+    }
+
+    delete_vertex_buffer( buffer_id );
+
+    capacity = size;
     return new_buffer;
   }
 
@@ -202,6 +293,43 @@ namespace mv {
     glDeleteBuffers( 1, &buffer_id );
   }
 
+  uint32_t create_uniform_buffer( size_t size_in_bytes, const void* data ) {
+    PROFILE_FUNCTION();
+
+    GLuint id = 0;
+
+    /* allocate the OpenGL buffer object */
+    glCreateBuffers( 1, &id );
+    if ( id == 0 )
+      THROW( "failed to create opengl buffer object" );
+
+    /* the size is fixed, the data is rewritten with `update_uniform_buffer` */
+    glNamedBufferStorage( id, size_in_bytes, data, GL_DYNAMIC_STORAGE_BIT );
+
+    LOG_INFO( "created opengl uniform buffer: id = {}", id );
+    return (uint32_t)id;
+  }
+
+  void delete_uniform_buffer( uint32_t buffer_id ) {
+    PROFILE_FUNCTION();
+
+    LOG_INFO( "deleted opengl uniform buffer: id = {}", buffer_id );
+    glDeleteBuffers( 1, &buffer_id );
+  }
+
+  void update_uniform_buffer( uint32_t buffer_id, size_t size_in_bytes, const void* data ) {
+    PROFILE_FUNCTION();
+
+    MV_ASSERT( buffer_id != 0 );
+    glNamedBufferSubData( buffer_id, 0, size_in_bytes, data );
+  }
+
+  void bind_uniform_buffer( uint32_t binding, uint32_t buffer_id ) {
+    PROFILE_FUNCTION();
+
+    glBindBufferBase( GL_UNIFORM_BUFFER, binding, buffer_id );
+  }
+
   void retrieve_data( uint32_t buffer_id, size_t size, void* output_buffer ) {
     PROFILE_FUNCTION();
 
@@ -220,7 +348,7 @@ namespace mv {
     glUnmapNamedBuffer( buffer_id );
   }
 
-  IndexBuffer::IndexBuffer( const std::vector<uint32_t> indices ) : _num_indices( indices.size() ) {
+  IndexBuffer::IndexBuffer( const std::vector<uint32_t> indices ) : _num_indices( indices.size() ), _capacity( indices.size() * sizeof( uint32_t ) ) {
     PROFILE_FUNCTION();
 
     GLuint id = 0;
@@ -239,10 +367,30 @@ namespace mv {
     _buffer_id = id;
   }
 
+  IndexBuffer::IndexBuffer( size_t count, const uint32_t* data ) : _num_indices( count ), _capacity( count * sizeof( uint32_t ) ) {
+    PROFILE_FUNCTION();
+
+    GLuint id = 0;
+
+    /* allocate the OpenGL buffer object */
+    glCreateBuffers( 1, &id );
+    if ( id == 0 )
+      THROW( "failed to create opengl buffer object" );
+
+    /* the indices of a map layer change when it is edited */
+    glNamedBufferData( id, count * sizeof( uint32_t ), data, GL_DYNAMIC_DRAW );
+
+    LOG_INFO( "created opengl index_buffer buffer: id = {}", id );
+
+    /* assign member */
+    _buffer_id = id;
+  }
+
   IndexBuffer::~IndexBuffer( void ) {
     PROFILE_FUNCTION();
 
     LOG_INFO( "deleted opengl index_buffer buffer: id = {}", _buffer_id );
+    Shader::release_input_layouts( _buffer_id );
     glDeleteBuffers( 1, &_buffer_id );
   }
 
@@ -253,4 +401,40 @@ namespace mv {
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _buffer_id );
   }
 
+  void IndexBuffer::set_range( size_t offset, size_t count, const uint32_t* data ) {
+    PROFILE_FUNCTION();
+
+    if ( offset + count > _num_indices ) {
+      LOG_ERROR( "range out of bounds, cannot update index buffer data: num_indices = {}, requested_range = [{}, {})", _num_indices, offset, offset + count );
+      return;
+    }
+
+    if ( count > 0 )
+      update_vertex_buffer_element( _buffer_id, offset * sizeof( uint32_t ), count * sizeof( uint32_t ), data );
+  }
+
+  void IndexBuffer::replace( size_t offset, size_t indices_to_remove, size_t num_indices, const uint32_t* data ) {
+    PROFILE_FUNCTION();
+
+    MV_ASSERT( data || num_indices == 0 );
+
+    /* the memory is handled the same way as the one of a vertex buffer */
+    _buffer_id = replace_vertex_buffer_memory( _buffer_id, _capacity, _num_indices * sizeof( uint32_t ), offset * sizeof( uint32_t ), indices_to_remove * sizeof( uint32_t ),
+                                               num_indices * sizeof( uint32_t ), data );
+    _num_indices += ( num_indices - indices_to_remove );
+  }
+
+  void IndexBuffer::gather( size_t num_indices, const std::vector<BufferCopy>& copies ) {
+    PROFILE_FUNCTION();
+
+    std::vector<BufferCopy> byte_copies;
+    byte_copies.reserve( copies.size() );
+
+    for ( const auto& copy : copies )
+      byte_copies.push_back( { copy.from * sizeof( uint32_t ), copy.to * sizeof( uint32_t ), copy.size * sizeof( uint32_t ) } );
+
+    _buffer_id = gather_vertex_buffer( _buffer_id, _capacity, num_indices * sizeof( uint32_t ), byte_copies );
+    _num_indices = num_indices;
+  }
+
 }
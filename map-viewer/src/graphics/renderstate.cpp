@@ -1,8 +1,12 @@
 #include <graphics/renderstate.h>
 
+#include <algorithm>
+
 #include <glad/glad.h>
 #include <utils/logger.h>
 
+#include <graphics/buffers.h>
+
 #include "typemap.h"
 
 namespace mv {
@@ -15,6 +19,9 @@ namespace mv {
 
     /* push a default topology */
     push_topology( Topology::Point );
+
+    /* the largest index, `IndexBuffer::RESTART`, starts a new strip */
+    glEnable( GL_PRIMITIVE_RESTART_FIXED_INDEX );
   }
 
   RenderState::~RenderState( void ) {
@@ -23,6 +30,9 @@ namespace mv {
     pop_viewport();
     pop_topology();
 
+    if ( _scratch_buffer != 0 )
+      delete_vertex_buffer( _scratch_buffer );
+
     LOG_INFO( "render state destroyed" );
   }
 
@@ -44,6 +54,19 @@ namespace mv {
     _stats = Stats();
   }
 
+  uint32_t RenderState::scratch_buffer( size_t size ) {
+    if ( _scratch_capacity < size ) {
+      if ( _scratch_buffer != 0 )
+        delete_vertex_buffer( _scratch_buffer );
+
+      /* grow by half so that a few larger copies do not reallocate every time */
+      _scratch_capacity = std::max( size, _scratch_capacity * 3 / 2 );
+      _scratch_buffer = create_vertex_buffer( _scratch_capacity, nullptr );
+    }
+
+    return _scratch_buffer;
+  }
+
   void RenderState::push_topology( Topology topology ) {
     /* push the topology to the stack */
     _topologies.push( topology );
@@ -88,13 +111,7 @@ namespace mv {
   void RenderState::draw( uint32_t num_vertices, uint32_t offset ) {
     PROFILE_FUNCTION();
 
-    if ( _topologies.top() == Topology::Line )
-      _stats.num_lines += num_vertices / 2;
-    if ( _topologies.top() == Topology::Triangle )
-      _stats.num_triangles += num_vertices / 3;
-    if ( _topologies.top() == Topology::Point )
-      _stats.num_points += num_vertices;
-
+    count_primitives( num_vertices );
     _stats.draw_calls++;
 
     glDrawArrays( map( _topologies.top() ), offset, (GLsizei)num_vertices );
@@ -104,10 +121,41 @@ namespace mv {
   void RenderState::draw_index( uint32_t index_count, uint32_t offset ) {
     PROFILE_FUNCTION();
 
+    count_primitives( index_count );
+    _stats.draw_calls++;
+
     glDrawElements( map( _topologies.top() ), index_count, GL_UNSIGNED_INT, (void*)( offset * sizeof( GLuint ) ) );
     glFlush();
   }
 
+  void RenderState::draw_index( const DrawRanges& ranges ) {
+    PROFILE_FUNCTION();
+
+    if ( ranges.counts.empty() )
+      return;
+
+    _draw_offsets.clear();
+    for ( size_t i = 0; i < ranges.counts.size(); i++ ) {
+      count_primitives( ranges.counts[i] );
+      _draw_offsets.push_back( (const void*)( ranges.offsets[i] * sizeof( GLuint ) ) );
+    }
+    _stats.draw_calls++;
+
+    glMultiDrawElements( map( _topologies.top() ), (const GLsizei*)ranges.counts.data(), GL_UNSIGNED_INT, _draw_offsets.data(), (GLsizei)ranges.counts.size() );
+    glFlush();
+  }
+
+  void RenderState::count_primitives( uint32_t num_vertices ) {
+    if ( _topologies.top() == Topology::Line )
+      _stats.num_lines += num_vertices / 2;
+    if ( _topologies.top() == Topology::LineStrip && num_vertices > 0 )
+      _stats.num_lines += num_vertices - 1; /* the restarts are counted as lines too */
+    if ( _topologies.top() == Topology::Triangle )
+      _stats.num_triangles += num_vertices / 3;
+    if ( _topologies.top() == Topology::Point )
+      _stats.num_points += num_vertices;
+  }
+
   void RenderState::set_viewport( Viewport viewport ) {
     PROFILE_FUNCTION();
 
@@ -8,10 +8,15 @@
 #include <utils/logger.h>
 #include <utils/assert.h>
 
+#include <graphics/renderstate.h>
+
 #include "typemap.h"
 
 namespace mv {
 
+  /* every shader alive, to drop their input layouts when a buffer is deleted */
+  static std::vector<Shader*> s_shaders;
+
   /* check shader compilation and link errors */
   static bool get_shader_status( GLuint id, GLenum type ) {
     MV_ASSERT( type == GL_COMPILE_STATUS || type == GL_LINK_STATUS );
@@ -88,12 +93,17 @@ namespace mv {
     glDeleteShader( vertex_shader_id );
     glDeleteShader( fragment_shader_id );
 
+    s_shaders.push_back( this );
+
     LOG_INFO( "created OpenGL shader program: id = {}", _shader_program_id );
   }
 
   Shader::~Shader( void ) {
-    /* delete input layout if created */
-    delete_input_layout();
+    s_shaders.erase( std::remove( s_shaders.begin(), s_shaders.end(), this ), s_shaders.end() );
+
+    /* delete the input layouts created */
+    for ( InputLayout& layout : _input_layouts )
+      glDeleteVertexArrays( 1, &layout.vertex_attribute );
 
     /* delete the shader program */
     LOG_INFO( "deleted OpenGL shader program: id = {}", _shader_program_id );
@@ -103,7 +113,8 @@ namespace mv {
   void Shader::use( void ) {
     PROFILE_FUNCTION();
 
-    /* bind the vertex array if created */
+    /* bind the vertex array of the buffers set if any */
+    select_input_layout();
     bind_input_layout();
 
     /* bind the shader program to the pipeline */
@@ -131,7 +142,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniformMatrix4fv( location, 1, GL_FALSE, &matrix[0][0] );
+    set_mat4( UniformLocation{ location }, matrix );
+  }
+
+  void Shader::set_mat4( UniformLocation uniform, const glm::mat4& matrix ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniformMatrix4fv( uniform.location, 1, GL_FALSE, &matrix[0][0] );
   }
 
   void Shader::set_vec2( const string& uniform_name, const glm::vec2& vector ) const {
@@ -147,7 +165,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform2fv( location, 1, &vector[0] );
+    set_vec2( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_vec2( UniformLocation uniform, const glm::vec2& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform2fv( uniform.location, 1, &vector[0] );
   }
 
   void Shader::set_vec3( const string& uniform_name, const glm::vec3& vector ) const {
@@ -163,7 +188,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform3fv( location, 1, &vector[0] );
+    set_vec3( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_vec3( UniformLocation uniform, const glm::vec3& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform3fv( uniform.location, 1, &vector[0] );
   }
 
   void Shader::set_vec4( const string& uniform_name, const glm::vec4& vector ) const {
@@ -179,7 +211,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform4fv( location, 1, &vector[0] );
+    set_vec4( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_vec4( UniformLocation uniform, const glm::vec4& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform4fv( uniform.location, 1, &vector[0] );
   }
   
   void Shader::set_ivec2( const string& uniform_name, const glm::ivec2& vector ) const {
@@ -195,7 +234,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform2iv( location, 1, &vector[0] );
+    set_ivec2( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_ivec2( UniformLocation uniform, const glm::ivec2& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform2iv( uniform.location, 1, &vector[0] );
   }
 
   void Shader::set_ivec3( const string& uniform_name, const glm::ivec3& vector ) const {
@@ -211,7 +257,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform3iv( location, 1, &vector[0] );
+    set_ivec3( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_ivec3( UniformLocation uniform, const glm::ivec3& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform3iv( uniform.location, 1, &vector[0] );
   }
 
   void Shader::set_ivec4( const string& uniform_name, const glm::ivec4& vector ) const {
@@ -227,7 +280,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform4iv( location, 1, &vector[0] );
+    set_ivec4( UniformLocation{ location }, vector );
+  }
+
+  void Shader::set_ivec4( UniformLocation uniform, const glm::ivec4& vector ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform4iv( uniform.location, 1, &vector[0] );
   }
 
   void Shader::set_uint( const string& uniform_name, const uint32_t& value ) const {
@@ -243,7 +303,37 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform1ui( location, value );
+    set_uint( UniformLocation{ location }, value );
+  }
+
+  void Shader::set_uint( UniformLocation uniform, const uint32_t& value ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform1ui( uniform.location, value );
+  }
+
+  void Shader::set_float( const string& uniform_name, const float& value ) const {
+    PROFILE_FUNCTION();
+
+    /* get uniform location */
+    GLint location = get_uniform_location( uniform_name );
+
+    /* check valid location */
+    if ( location < 0 ) {
+      LOG_ERROR( "no uniform with name `{}` in use of the shader", uniform_name );
+      return;
+    }
+
+    /* set the uniform */
+    set_float( UniformLocation{ location }, value );
+  }
+
+  void Shader::set_float( UniformLocation uniform, const float& value ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform1f( uniform.location, value );
   }
 
   void Shader::set_int( const string& uniform_name, const int32_t& value ) const {
@@ -259,7 +349,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform1i( location, value );
+    set_int( UniformLocation{ location }, value );
+  }
+
+  void Shader::set_int( UniformLocation uniform, const int32_t& value ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform1i( uniform.location, value );
   }
 
   void Shader::set_int_array( const string& uniform_name, size_t size, const int32_t* value ) const {
@@ -275,7 +372,14 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform1iv( location, size, value );
+    set_int_array( UniformLocation{ location }, size, value );
+  }
+
+  void Shader::set_int_array( UniformLocation uniform, size_t size, const int32_t* value ) const {
+    PROFILE_FUNCTION();
+
+    /* set the uniform */
+    glUniform1iv( uniform.location, size, value );
   }
 
   void Shader::set_uint_array( const string& uniform_name, size_t size, const uint32_t* value ) const {
@@ -291,22 +395,29 @@ namespace mv {
     }
 
     /* set the uniform */
-    glUniform1uiv( location, size, value );
+    set_uint_array( UniformLocation{ location }, size, value );
   }
 
-  void Shader::create_input_layout( const std::vector<Shader::InputLayoutDesc>& ild ) {
+  void Shader::set_uint_array( UniformLocation uniform, size_t size, const uint32_t* value ) const {
     PROFILE_FUNCTION();
 
-    /* delete previous input layout if any */
-    delete_input_layout();
+    /* set the uniform */
+    glUniform1uiv( uniform.location, size, value );
+  }
+
+  uint32_t Shader::create_input_layout( const std::vector<Shader::InputLayoutDesc>& ild, uint32_t index_buffer_id ) {
+    PROFILE_FUNCTION();
 
     /* create the OpenGL vertex attribute object */
-    glCreateVertexArrays( 1, &_vertex_attribute );
-    if ( _vertex_attribute == 0 )
+    GLuint vertex_attribute = 0;
+    glCreateVertexArrays( 1, &vertex_attribute );
+    if ( vertex_attribute == 0 )
       THROW( "failed to create OpenGL vertex attribute object" );
 
+    RenderState::ref().count_input_layout();
+
     /* bind the vertex attribute object to capture state changes */
-    bind_input_layout();
+    glBindVertexArray( vertex_attribute );
 
     for ( const auto& layout : ild ) {
 
@@ -343,6 +454,10 @@ namespace mv {
       bind_vertex_buffer( 0 );
     }
 
+    /* the index buffer is part of the input layout */
+    if ( index_buffer_id != 0 )
+      glVertexArrayElementBuffer( vertex_attribute, index_buffer_id );
+
     /* unbind the vertex array */
     unbind_input_layout();
 
@@ -359,11 +474,83 @@ namespace mv {
 
     LOG_DEBUG( "------------------------------------------" );
   #endif
+
+    return (uint32_t)vertex_attribute;
   }
 
-  void Shader::delete_input_layout( void ) {
-    if ( _vertex_attribute != 0 )
-      glDeleteVertexArrays( 1, &_vertex_attribute );
+  void Shader::set_index_buffer( Ref<IndexBuffer> indices ) {
+    PROFILE_FUNCTION();
+
+    MV_ASSERT( _input_key.vertex_buffers[0] != 0 );
+
+    /* the index buffer is part of the input layout, it replaces any set before */
+    if ( indices->buffer_id() == _input_key.index_buffer )
+      return;
+
+    _input_key.index_buffer = indices->buffer_id();
+    _vertex_attribute = 0;
+
+    /* hold a reference like the vertex buffers */
+    _set_indices = indices;
+  }
+
+  void Shader::release_input_layouts( uint32_t buffer_id ) {
+    PROFILE_FUNCTION();
+
+    /* 0 marks the unused entries of the keys */
+    if ( buffer_id == 0 )
+      return;
+
+    for ( Shader* shader : s_shaders )
+      shader->delete_input_layouts( buffer_id );
+  }
+
+  void Shader::delete_input_layouts( uint32_t buffer_id ) {
+    for ( auto it = _input_layouts.begin(); it != _input_layouts.end(); ) {
+      if ( !it->key.uses( buffer_id ) ) {
+        ++it;
+        continue;
+      }
+
+      if ( it->vertex_attribute == _vertex_attribute )
+        _vertex_attribute = 0;
+
+      glDeleteVertexArrays( 1, &it->vertex_attribute );
+      it = _input_layouts.erase( it );
+    }
+
+    _input_layout_descs.erase( std::remove_if( _input_layout_descs.begin(), _input_layout_descs.end(), [&]( const InputLayoutDescs& desc ) {
+      return std::find( desc.vertex_buffers.begin(), desc.vertex_buffers.end(), buffer_id ) != desc.vertex_buffers.end();
+    } ), _input_layout_descs.end() );
+  }
+
+  void Shader::select_input_layout( void ) {
+    PROFILE_FUNCTION();
+
+    /* the buffers did not change since the last selection */
+    if ( _vertex_attribute != 0 || _input_key.vertex_buffers[0] == 0 )
+      return;
+
+    auto it = std::find_if( _input_layouts.begin(), _input_layouts.end(), [&]( const InputLayout& layout ) {
+      return layout.key == _input_key;
+    } );
+
+    /* first use of the buffers, create the input layout */
+    if ( it == _input_layouts.end() ) {
+      auto desc = std::find_if( _input_layout_descs.begin(), _input_layout_descs.end(), [&]( const InputLayoutDescs& d ) {
+        return d.vertex_buffers == _input_key.vertex_buffers;
+      } );
+
+      if ( desc == _input_layout_descs.end() ) {
+        LOG_ERROR( "the input buffers were deleted after they were set" );
+        return;
+      }
+
+      _input_layouts.push_back( { _input_key, create_input_layout( desc->descs, _input_key.index_buffer ) } );
+      it = _input_layouts.end() - 1;
+    }
+
+    _vertex_attribute = it->vertex_attribute;
   }
 
   void Shader::bind_input_layout( void ) const {
@@ -29,20 +29,54 @@
 
 using namespace mv;
 
+/* binding points of the uniform blocks of the shaders below */
+constexpr uint32_t CAMERA_BLOCK_BINDING = 0;
+constexpr uint32_t LAYER_BLOCK_BINDING  = 1;
+
+/* fixed locations of the uniforms of the shaders below */
+constexpr UniformLocation MODE_UNIFORM            = { 0 };
+constexpr UniformLocation HIGHLIGHT_COLOR_UNIFORM = { 1 };
+constexpr UniformLocation HIGHLIGHT_NUM_UNIFORM   = { 2 };
+constexpr UniformLocation HIGHLIGHT_UNIFORM       = { 3 };
+
+/* what the `mode` uniform draws */
+constexpr int32_t DRAW_FILL             = 0;
+constexpr int32_t DRAW_OUTLINE          = 1;
+constexpr int32_t DRAW_SELECTED_OUTLINE = 2;
+
+/* uniforms of the `Camera` block, in the std140 layout */
+struct CameraUniforms {
+  glm::mat4 view_projection = glm::mat4( 1.0f );
+};
+
 constexpr char vs[] = R"(
   #version 460 core
 
-  layout ( location = 0 ) in vec3  a_position;
-  layout ( location = 1 ) in uvec2 a_id;
+  layout ( location = 0 ) in ivec2 a_position;
+  layout ( location = 1 ) in uint  a_id;
+
+  /* written once per frame, the view is relative to the eye */
+  layout ( std140, binding = 0 ) uniform Camera {
+    mat4 view_projection;
+  } camera;
 
-  uniform mat4 projection;
-  uniform mat4 view;
+  /* camera position on the grid of the layer, a cell and the offset from it */
+  layout ( std140, binding = 1 ) uniform Layer {
+    ivec2 eye_cell;
+    vec2  eye_offset;
+    vec4  fill_color;
+    vec4  line_color;
+    float grid_step;
+  } layer;
 
   flat out uint pass_polygon_id;
 
   void main() {
-    pass_polygon_id = a_id.x;
-    gl_Position = projection * view * vec4( a_position, 1.0f );
+    pass_polygon_id = a_id;
+
+    /* relative to eye, the cells are subtracted exactly in integers */
+    vec2 position = ( vec2( a_position - layer.eye_cell ) - layer.eye_offset ) * layer.grid_step;
+    gl_Position = camera.view_projection * vec4( position, 0.0f, 1.0f );
   }
 )";
 
@@ -52,63 +86,32 @@ constexpr char ps[] = R"(
   layout( location = 0 ) out vec4 frag_color;
   layout( location = 1 ) out vec4 polygon_id;
 
-  uniform vec4 color;
-  uniform vec4 highlight_color;
-
-  uniform int rectangular_selection;
-  uniform ivec2 mouse_pos;
-  uniform ivec3 horizontal;
-  uniform ivec3 vertical;
+  layout ( std140, binding = 1 ) uniform Layer {
+    ivec2 eye_cell;
+    vec2  eye_offset;
+    vec4  fill_color;
+    vec4  line_color;
+    float grid_step;
+  } layer;
 
-  uniform int highlight_num;
-  uniform uint highlight[64];
+  /* the fill, the outlines or the selected outlines */
+  layout ( location = 0 ) uniform int mode;
 
-  uniform int is_selected;
+  layout ( location = 1 ) uniform vec4 highlight_color;
 
-  layout ( std430 ) volatile buffer polygon_ids {
-    int written_elements;
-    int polygon_ids_buffer[];
-  };
+  layout ( location = 2 ) uniform int highlight_num;
+  layout ( location = 3 ) uniform uint highlight[64];
 
   flat in uint pass_polygon_id;
 
   void main() {
 
-    frag_color = vec4( color );
-
-    if ( is_selected != 1 ) {
+    if ( mode == 2 ) {
+      frag_color = highlight_color;
       return;
     }
 
-    int x = int( gl_FragCoord.x - 0.5f );
-    int y = int( gl_FragCoord.y - 0.5f );
-    
-    if ( rectangular_selection != 1 ) {
-      if ( x == mouse_pos.x && y == mouse_pos.y && pass_polygon_id != 0 && written_elements < polygon_ids_buffer.length() ) {
-        int index = atomicAdd( written_elements, 1 );
-        atomicAdd( polygon_ids_buffer[index], int( pass_polygon_id ) );
-      }
-    } else {
-      /* horizontal */
-
-      ivec2 hy = ivec2( min( horizontal.y, horizontal.z ), max( horizontal.y, horizontal.z ) );
-
-      if ( x == horizontal.x && y >= hy.x && y <= hy.y &&
-           pass_polygon_id != 0 && written_elements < polygon_ids_buffer.length() ) {
-        int index = atomicAdd( written_elements, 1 );
-        atomicAdd( polygon_ids_buffer[index], int( pass_polygon_id ) );
-      }
-
-      /* vertical */
-
-      ivec2 vx = ivec2( min( vertical.y, vertical.z ), max( vertical.y, vertical.z ) );
-
-      if ( y == vertical.x && x >= vx.x && x <= vx.y &&
-           pass_polygon_id != 0 && written_elements < polygon_ids_buffer.length() ) {
-        int index = atomicAdd( written_elements, 1 );
-        atomicAdd( polygon_ids_buffer[index], int( pass_polygon_id ) );
-      }
-    }
+    frag_color = mode == 0 ? layer.fill_color : layer.line_color;
 
     int i = 0;
     for ( i = 0; i < highlight_num; i++ ) {
@@ -119,12 +122,8 @@ constexpr char ps[] = R"(
   }
 )";
 
-constexpr int MAX_ARRAY_SIZE = 4096;
-
-struct PolygonIDBuffer {
-  int32_t written_elements            = 0;
-  int32_t polygon_ids[MAX_ARRAY_SIZE] = {};
-};
+/* distance in pixels from an outline within which a click picks it */
+constexpr double PICK_PIXEL_TOLERANCE = 3.0;
 
 Ref<ApplicationMenu> menu;
 
@@ -134,8 +133,6 @@ public:
     _color_buffer = new Texture2D( Window::ref().width(), Window::ref().height(), TextureFormat::rgba8 );
     _polygon_id_buffer = new Texture2D( Window::ref().width(), Window::ref().height(), TextureFormat::rgba32f );
 
-    _ssbo = new ShaderStorageBuffer<PolygonIDBuffer>( nullptr );
-
     _framebuffer = new Framebuffer( true, Window::ref().width(), Window::ref().height() );
     _framebuffer->set_color_attachment( _color_buffer, 0 );
     _framebuffer->set_color_attachment( _polygon_id_buffer, 1 );
@@ -143,11 +140,12 @@ public:
     _map_layers.push_back( new MapLayer( "json/countries.geojson" ) );
 
     _ss = new Shader( vs, ps );
+    _camera_uniforms = new UniformBuffer<CameraUniforms>();
     
     Box bbox = _map_layers[0]->bounding_box();
 
     auto c = bbox.center();
-    c.z = 0.5f;
+    c.z = 0.5;
 
     _camera = new OrthoCamera();
     _camera->set_position( c );
@@ -174,16 +172,26 @@ public:
     if ( _editor_layer->is_editing() )
       _editor_layer->update( delta_time );
     else if ( selected_layer != nullptr ) {
-      if ( Input::is_mouse_button_pressed( MOUSE_BUTTON_LEFT ) || _selector.is_dragging() ) {
-        PolygonIDBuffer buff = ( *_ssbo )[0];
+      /* the z of the camera is the size of a pixel in the units of the positions */
+      if ( Input::is_mouse_button_pressed( MOUSE_BUTTON_LEFT ) ) {
+        if ( !Input::is_key_down( KEY_LEFT_CONTROL ) )
+          selected_layer->clear_selected();
 
+        double tolerance = PICK_PIXEL_TOLERANCE * _camera->get_position().z;
+        for ( polygon_id id : selected_layer->pick( _camera->get_mouse_world_pos(), tolerance ) )
+          selected_layer->revert_select( id );
+      }
+      else if ( _selector.is_dragging() ) {
         if ( !Input::is_key_down( KEY_LEFT_CONTROL ) )
           selected_layer->clear_selected();
 
-        buff.written_elements = std::clamp( buff.written_elements, 0, MAX_ARRAY_SIZE );
-        for ( int32_t i = 0; i < buff.written_elements; i++ ) {
-          selected_layer->revert_select( buff.polygon_ids[i] );
-        }
+        /* the rectangle selects the geometries whose box overlaps it */
+        Box box;
+        box.include( glm::dvec3( _camera->screen_to_world( _selector.top_left() ), 0.0 ) );
+        box.include( glm::dvec3( _camera->screen_to_world( _selector.bottom_right() ), 0.0 ) );
+
+        for ( polygon_id id : selected_layer->query( box ) )
+          selected_layer->select( id );
       }
     }
 
@@ -225,6 +233,13 @@ public:
     _framebuffer->bind();
     _framebuffer->clear();
 
+    /* the layers are drawn relative to the eye, so the view is taken at the camera position */
+    CameraUniforms camera_uniforms;
+    camera_uniforms.view_projection = _camera->projection() * _camera->view( _camera->get_position() );
+
+    _camera_uniforms->set( camera_uniforms );
+    _camera_uniforms->bind( CAMERA_BLOCK_BINDING );
+
     for ( auto it = _map_layers.rbegin(); it < _map_layers.rend(); it++ ) {
       if ( !(*it)->is_hidden() )
         render_layer( *it );
@@ -236,61 +251,37 @@ public:
   void render_layer( Ref<MapLayer> layer ) {
     PROFILE_FUNCTION();
 
-    bool layer_selected = layer == menu->selected_layer();
+    /* the vertex buffers never change with the camera, only the eye does */
+    layer->update_uniforms( _camera->get_position() )->bind( LAYER_BLOCK_BINDING );
+
+    /* the z of the camera is the size of a pixel in the units of the positions, the */
+    /* selected outlines below are always drawn with the full resolution             */
+    uint32_t level = layer->lod_level( _camera->get_position().z );
+
+    /* the simplified levels of the edited geometries are built when first drawn */
+    if ( level > 0 )
+      layer->update_lods();
+
+    /* only the chunks of geometries in the window are drawn */
+    layer->visible_ranges( level, _camera->view_box(), _triangle_ranges, _outline_ranges );
 
     if ( layer->should_draw_triangles() ) {
 
       RenderState::ref().push_topology( Topology::Triangle );
       {
         _ss->set_input_buffers( layer->vertex_buffer() );
+        _ss->set_index_buffer( layer->triangle_buffer() );
         _ss->use();
 
-        /* temporary draw function */
-        _ss->set_mat4( "projection", _camera->projection() );
-        _ss->set_mat4( "view", _camera->view() );
-        _ss->set_vec4( "color", layer->get_polygon_fill_color() );
-        _ss->set_vec4( "highlight_color", menu->view_mode_polygon_highligh_color() );
-        
-        _ss->set_ssbo( "polygon_ids", _ssbo );
-
-        if ( _selector.is_dragging() ) {
-          glm::ivec2 top_left = _selector.top_left();
-          glm::ivec2 bottom_right = _selector.bottom_right();
-          int height = _framebuffer->height();
-
-          top_left.y = height - top_left.y;
-          bottom_right.y = height - bottom_right.y;
-
-          glm::ivec3 horizontal = _selector.horizontal();
-          glm::ivec3 vertical = _selector.vertical();
-
-          horizontal.y = height - horizontal.y;
-          horizontal.z = height - horizontal.z;
-
-          vertical.x = height - vertical.x;
-
-          _ss->set_int( "rectangular_selection", (int)1 );
-          _ss->set_ivec3( "horizontal", horizontal );
-          _ss->set_ivec3( "vertical", vertical );
-        }
-        else {
-          _ss->set_int( "rectangular_selection", (int)0 );
-          _ss->set_ivec2( "mouse_pos", { (int32_t)Input::mouse_position().x, (int32_t)_framebuffer->height() - (int32_t)Input::mouse_position().y } );
-        }
+        _ss->set_int( MODE_UNIFORM, DRAW_FILL );
+        _ss->set_vec4( HIGHLIGHT_COLOR_UNIFORM, menu->view_mode_polygon_highligh_color() );
 
         auto& selected = layer->selected_geometries();
 
-        _ss->set_int( "highlight_num", (int)selected.size() );
-        _ss->set_uint_array( "highlight", selected.size(), selected.data() );
-
-        _ss->set_int( "is_selected", layer_selected ? 1 : 0 );
-
-        RenderState::ref().draw( layer->vertex_buffer()->array_size() );
-
-        if ( layer_selected ) {
-          _ssbo->retrieve();
-        }
+        _ss->set_int( HIGHLIGHT_NUM_UNIFORM, (int)selected.size() );
+        _ss->set_uint_array( HIGHLIGHT_UNIFORM, selected.size(), selected.data() );
 
+        RenderState::ref().draw_index( _triangle_ranges );
       }
       RenderState::ref().pop_topology();
 
@@ -298,29 +289,32 @@ public:
 
     if ( layer->should_draw_outlines() ) {
 
-      RenderState::ref().push_topology( Topology::Line );
+      RenderState::ref().push_topology( Topology::LineStrip );
       {
         RenderState::ref().set_line_thickenss( layer->get_line_thickness() );
 
-        _ss->set_input_buffers( layer->outline_buffer() );
+        /* the outlines share the vertices of the triangles */
+        _ss->set_input_buffers( layer->vertex_buffer() );
+        _ss->set_index_buffer( layer->outline_buffer() );
         _ss->use();
 
-        _ss->set_mat4( "projection", _camera->projection() );
-        _ss->set_mat4( "view", _camera->view() );
-        _ss->set_vec4( "color", layer->get_line_color() );
+        /* the selected outlines are drawn again below, the outlines are not highlighted */
+        _ss->set_int( MODE_UNIFORM, DRAW_OUTLINE );
+        _ss->set_int( HIGHLIGHT_NUM_UNIFORM, 0 );
 
-        RenderState::ref().draw( layer->outline_buffer()->array_size() );
+        RenderState::ref().draw_index( _outline_ranges );
       }
       {
         auto& selected = layer->selected_geometries();
 
         if ( selected.size() > 0 ) {
           RenderState::ref().set_line_thickenss( menu->view_mode_line_highlight_thickness() );
-          _ss->set_vec4( "color", menu->view_mode_line_highligh_color() );
+          _ss->set_int( MODE_UNIFORM, DRAW_SELECTED_OUTLINE );
+          _ss->set_vec4( HIGHLIGHT_COLOR_UNIFORM, menu->view_mode_line_highligh_color() );
 
           for ( const auto& id : selected ) {
             auto [offset, size] = layer->get_outline_indices( id );
-            RenderState::ref().draw( size, offset );
+            RenderState::ref().draw_index( size, offset );
           }
         }
 
@@ -339,13 +333,18 @@ public:
       top_left.y = height - top_left.y;
       bottom_right.y = height - bottom_right.y;
 
-      Immgfx::ref().push_vertex( glm::vec3( top_left.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) );
-      Immgfx::ref().push_vertex( glm::vec3( bottom_right.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) );
-      Immgfx::ref().push_vertex( glm::vec3( top_left.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) );
+      /* the two triangles of the rectangle */
+      const Immgfx::Vertex rectangle[] = {
+        { glm::vec3( top_left.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) },
+        { glm::vec3( bottom_right.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) },
+        { glm::vec3( top_left.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) },
+
+        { glm::vec3( top_left.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) },
+        { glm::vec3( bottom_right.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) },
+        { glm::vec3( bottom_right.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) }
+      };
 
-      Immgfx::ref().push_vertex( glm::vec3( top_left.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) );
-      Immgfx::ref().push_vertex( glm::vec3( bottom_right.x, top_left.y, 0.0f ), glm::vec4( 0.5f ) );
-      Immgfx::ref().push_vertex( glm::vec3( bottom_right.x, bottom_right.y, 0.0f ), glm::vec4( 0.5f ) );
+      Immgfx::ref().push_vertices( rectangle, 6 );
 
       Immgfx::ref().draw( glm::ortho( 0.0f, (float)_framebuffer->width(), 0.0f, height ), glm::mat4( 1.0f ), Topology::Triangle );
     }
@@ -391,13 +390,19 @@ private:
   std::vector<Ref<MapLayer>> _map_layers;
 
   Ref<Shader> _ss;
-  Ref<ShaderStorageBuffer<PolygonIDBuffer>> _ssbo;
+
+  /* camera of the frame for the shader above */
+  Ref<UniformBuffer<CameraUniforms>> _camera_uniforms;
 
   Ref<Texture2D>   _color_buffer;
   Ref<Texture2D>   _polygon_id_buffer;
   Ref<Framebuffer> _framebuffer;
 
   RectangularSelector _selector;
+
+  /* ranges of the indices of the layer being drawn, kept between frames */
+  DrawRanges _triangle_ranges;
+  DrawRanges _outline_ranges;
 };
 
 int main( int argc, char* argv[] ) {
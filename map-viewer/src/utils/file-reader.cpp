@@ -3,28 +3,155 @@
 #include <utils/logger.h>
 #include <utf8/utf8.h>
 
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
 namespace mv {
    
   DataFile::DataFile( void ) {
 
   }
 
-  DataFile::DataFile( const string& filename ) {
-    open( filename );
+  DataFile::DataFile( const string& filename, Mode mode ) {
+    open( filename, mode );
+  }
+
+  DataFile::~DataFile( void ) {
+    close();
   }
 
-  void DataFile::open( const string& filename ) {
-    _wif.open( filename, std::ios::in | std::ios::binary );
+  void DataFile::open( const string& filename, Mode mode ) {
+    close();
+
+    _mode = mode;
+
+    if ( _mode == Mode::Stream ) {
+      _wif.open( filename, std::ios::in | std::ios::binary );
+
+      if ( !_wif ) {
+        LOG_ERROR( "failed to open file: {}", filename );
+        return;
+      }
+
+      _wss << _wif.rdbuf();
+      return;
+    }
+
+  #ifdef _WIN32
+    HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( file == INVALID_HANDLE_VALUE ) {
+      LOG_ERROR( "failed to open file: {}", filename );
+      return;
+    }
+
+    _file_handle = file;
+
+    LARGE_INTEGER file_size = {};
+    if ( !GetFileSizeEx( file, &file_size ) ) {
+      LOG_ERROR( "failed to get the size of file: {}", filename );
+      close();
+      return;
+    }
+
+    _mapped_size = (size_t)file_size.QuadPart;
 
-    if ( !_wif ) {
+    /* an empty file cannot be mapped, it is simply an empty view */
+    if ( _mapped_size > 0 ) {
+      _mapping_handle = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+      if ( _mapping_handle == nullptr ) {
+        LOG_ERROR( "failed to map file: {}", filename );
+        close();
+        return;
+      }
+
+      _mapped_data = (const char*)MapViewOfFile( _mapping_handle, FILE_MAP_READ, 0, 0, 0 );
+      if ( _mapped_data == nullptr ) {
+        LOG_ERROR( "failed to map file: {}", filename );
+        close();
+        return;
+      }
+    }
+  #else
+    _file_descriptor = ::open( filename.c_str(), O_RDONLY );
+    if ( _file_descriptor < 0 ) {
       LOG_ERROR( "failed to open file: {}", filename );
       return;
     }
 
-    _wss << _wif.rdbuf();
+    struct stat file_stat = {};
+    if ( fstat( _file_descriptor, &file_stat ) != 0 ) {
+      LOG_ERROR( "failed to get the size of file: {}", filename );
+      close();
+      return;
+    }
+
+    _mapped_size = (size_t)file_stat.st_size;
+
+    /* an empty file cannot be mapped, it is simply an empty view */
+    if ( _mapped_size > 0 ) {
+      void* data = mmap( nullptr, _mapped_size, PROT_READ, MAP_PRIVATE, _file_descriptor, 0 );
+      if ( data == MAP_FAILED ) {
+        LOG_ERROR( "failed to map file: {}", filename );
+        close();
+        return;
+      }
+
+      /* the files are mostly read from front to back, let the OS read ahead */
+      madvise( data, _mapped_size, MADV_SEQUENTIAL );
+
+      _mapped_data = (const char*)data;
+    }
+  #endif
+
+    _is_mapped = true;
+  }
+
+  void DataFile::close( void ) {
+    if ( _wif.is_open() )
+      _wif.close();
+
+    _wss.str( string() );
+    _wss.clear();
+
+  #ifdef _WIN32
+    if ( _mapped_data )
+      UnmapViewOfFile( _mapped_data );
+
+    if ( _mapping_handle )
+      CloseHandle( (HANDLE)_mapping_handle );
+
+    if ( _file_handle )
+      CloseHandle( (HANDLE)_file_handle );
+
+    _file_handle = nullptr;
+    _mapping_handle = nullptr;
+  #else
+    if ( _mapped_data )
+      munmap( (void*)_mapped_data, _mapped_size );
+
+    if ( _file_descriptor >= 0 )
+      ::close( _file_descriptor );
+
+    _file_descriptor = -1;
+  #endif
+
+    _mapped_data = nullptr;
+    _mapped_size = 0;
+    _is_mapped = false;
   }
 
   string DataFile::content( void ) {
+    if ( _mode == Mode::Mapped )
+      return string( view() );
+
     return _wss.str();
   }
 